@@ -8,6 +8,7 @@ URL:        https://github.com/sailfishos/nemo-qml-plugin-alarms
 Source0:    %{name}-%{version}.tar.bz2
 Requires:   timed-qt5 >= 2.88
 BuildRequires:  pkgconfig(Qt5Core)
+BuildRequires:  pkgconfig(Qt5Concurrent)
 BuildRequires:  pkgconfig(Qt5Qml)
 BuildRequires:  pkgconfig(Qt5DBus)
 BuildRequires:  pkgconfig(Qt5Test)
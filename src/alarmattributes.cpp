@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#include "alarmattributes.h"
+#include <QDateTime>
+
+// Perfect hash over the known attribute names, from their length and their first and last
+// characters. The same function is evaluated at compile time for the case labels below, so
+// a collision between two names fails to build.
+template <int N>
+static constexpr int nameHash(const char (&name)[N])
+{
+    return (5 * (N - 1) + 4 * (name[0] + name[N - 2])) & 31;
+}
+
+static inline int nameHash(const QString &name)
+{
+    return (5 * name.size() + 4 * (name.at(0).unicode() + name.at(name.size() - 1).unicode())) & 31;
+}
+
+AlarmAttributes::Key AlarmAttributes::key(const QString &name)
+{
+    if (name.isEmpty())
+        return Unknown;
+
+    switch (nameHash(name)) {
+    case nameHash("TITLE"):
+        return name == QLatin1String("TITLE") ? Title : Unknown;
+    case nameHash("COOKIE"):
+        return name == QLatin1String("COOKIE") ? Cookie : Unknown;
+    case nameHash("daysOfWeek"):
+        return name == QLatin1String("daysOfWeek") ? DaysOfWeek : Unknown;
+    case nameHash("createdDate"):
+        return name == QLatin1String("createdDate") ? CreatedDate : Unknown;
+    case nameHash("elapsed"):
+        return name == QLatin1String("elapsed") ? Elapsed : Unknown;
+    case nameHash("timeOfDayWithSeconds"):
+        return name == QLatin1String("timeOfDayWithSeconds") ? TimeOfDayWithSeconds : Unknown;
+    case nameHash("timeOfDay"):
+        return name == QLatin1String("timeOfDay") ? TimeOfDay : Unknown;
+    case nameHash("STATE"):
+        return name == QLatin1String("STATE") ? State : Unknown;
+    case nameHash("triggerTime"):
+        return name == QLatin1String("triggerTime") ? TriggerTime : Unknown;
+    case nameHash("startDate"):
+        return name == QLatin1String("startDate") ? StartDate : Unknown;
+    case nameHash("endDate"):
+        return name == QLatin1String("endDate") ? EndDate : Unknown;
+    case nameHash("uid"):
+        return name == QLatin1String("uid") ? Uid : Unknown;
+    case nameHash("recurrenceId"):
+        return name == QLatin1String("recurrenceId") ? RecurrenceId : Unknown;
+    case nameHash("timeoutSnoozeCounter"):
+        return name == QLatin1String("timeoutSnoozeCounter") ? TimeoutSnoozeCounter : Unknown;
+    case nameHash("maximalTimeoutSnoozeCounter"):
+        return name == QLatin1String("maximalTimeoutSnoozeCounter") ? MaximalTimeoutSnoozeCounter : Unknown;
+    case nameHash("notebook"):
+        return name == QLatin1String("notebook") ? Notebook : Unknown;
+    case nameHash("phoneNumber"):
+        return name == QLatin1String("phoneNumber") ? PhoneNumber : Unknown;
+    case nameHash("type"):
+        return name == QLatin1String("type") ? Type : Unknown;
+    }
+
+    return Unknown;
+}
+
+qint64 AlarmAttributes::toInteger(const QString &value, bool *ok)
+{
+    const QChar *c = value.constData();
+    const QChar *end = c + value.size();
+
+    bool negative = false;
+    if (c != end && (*c == QLatin1Char('-') || *c == QLatin1Char('+'))) {
+        negative = *c == QLatin1Char('-');
+        c++;
+    }
+
+    bool valid = c != end && end - c <= 18;
+    qint64 result = 0;
+    for (; valid && c != end; c++) {
+        ushort digit = c->unicode() - '0';
+        if (digit > 9)
+            valid = false;
+        else
+            result = result * 10 + digit;
+    }
+
+    if (ok)
+        *ok = valid;
+    if (!valid)
+        return 0;
+    return negative ? -result : result;
+}
+
+// Milliseconds since the epoch are stored by current versions. Previous versions stored a
+// stringified QDateTime, which caused problems with different locales; anything else is
+// taken as the epoch.
+qint64 AlarmAttributes::toCreatedMSecs(const QString &value)
+{
+    bool ok = false;
+    qint64 msecs = toInteger(value, &ok);
+    if (ok)
+        return msecs;
+
+    QDateTime date = QDateTime::fromString(value);
+    return date.isValid() ? date.toMSecsSinceEpoch() : 0;
+}
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#include "alarmfiltermodel.h"
+#include "alarmsbackendmodel.h"
+#include "alarmstore.h"
+#include "alarmobject.h"
+#include <qqmlinfo.h>
+
+/*!
+ *  \qmltype AlarmFilterModel
+ *  \inqmlmodule Nemo.Alarms
+ *
+ *  Shows the alarms of an AlarmsModel that pass all of the criteria in use.
+ *  Whether an alarm passes each criterion is kept in an index that is updated
+ *  as the source rows change, so changing one criterion only checks that
+ *  criterion for each alarm.
+ */
+
+AlarmFilterModel::AlarmFilterModel(QObject *parent)
+    : QSortFilterProxyModel(parent), m_model(0), m_alarmType(-1), m_enabledState(AnyState),
+      m_daysOfWeekMask(0), m_timeRangeStart(-1), m_timeRangeEnd(-1)
+{
+    setDynamicSortFilter(true);
+}
+
+/*!
+ *  \qmlproperty AlarmsModel AlarmFilterModel::model
+ *
+ *  The model whose alarms are filtered.
+ */
+QObject *AlarmFilterModel::model() const
+{
+    return sourceModel();
+}
+
+void AlarmFilterModel::setModel(QObject *model)
+{
+    if (model == sourceModel())
+        return;
+
+    AlarmsBackendModel *alarmModel = qobject_cast<AlarmsBackendModel*>(model);
+    if (model && !alarmModel) {
+        qmlInfo(this) << "AlarmFilterModel expects a AlarmsBackendModel model type";
+        return;
+    }
+    setSourceModel(alarmModel);
+    emit modelChanged();
+}
+
+void AlarmFilterModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    if (sourceModel == this->sourceModel())
+        return;
+
+    if (m_model)
+        m_model->disconnect(this);
+    m_model = qobject_cast<AlarmsBackendModel*>(sourceModel);
+    m_index.clear();
+
+    // The index has to follow the source before the proxy filters the rows, so it is
+    // connected first
+    if (m_model) {
+        connect(m_model, SIGNAL(rowsInserted(QModelIndex,int,int)), SLOT(sourceRowsInserted(QModelIndex,int,int)));
+        connect(m_model, SIGNAL(rowsRemoved(QModelIndex,int,int)), SLOT(sourceRowsRemoved(QModelIndex,int,int)));
+        connect(m_model, SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)),
+                SLOT(sourceRowsMoved(QModelIndex,int,int,QModelIndex,int)));
+        connect(m_model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), SLOT(sourceDataChanged(QModelIndex,QModelIndex)));
+        connect(m_model, SIGNAL(modelReset()), SLOT(rebuildIndex()));
+        connect(m_model, SIGNAL(layoutChanged()), SLOT(rebuildIndex()));
+        rebuildIndex();
+    }
+
+    QSortFilterProxyModel::setSourceModel(m_model);
+}
+
+/*!
+ *  \qmlproperty int AlarmFilterModel::alarmType
+ *
+ *  Only show alarms of this Alarm::type. -1, the default, shows alarms of all types.
+ */
+void AlarmFilterModel::setAlarmType(int type)
+{
+    if (m_alarmType == type)
+        return;
+
+    m_alarmType = type;
+    updateCriterion(TypeMatch);
+    emit alarmTypeChanged();
+}
+
+/*!
+ *  \qmlproperty enumeration AlarmFilterModel::enabledState
+ *
+ *  \list
+ *  \li AlarmFilterModel.AnyState - show alarms whether enabled or not, the default
+ *  \li AlarmFilterModel.EnabledOnly - only show enabled alarms
+ *  \li AlarmFilterModel.DisabledOnly - only show disabled alarms
+ *  \endlist
+ */
+void AlarmFilterModel::setEnabledState(int state)
+{
+    if (m_enabledState == state)
+        return;
+
+    m_enabledState = state;
+    updateCriterion(EnabledMatch);
+    emit enabledStateChanged();
+}
+
+/*!
+ *  \qmlproperty int AlarmFilterModel::daysOfWeekMask
+ *
+ *  Only show alarms that recur on at least one of these weekdays, a combination of
+ *  Alarm.DayOfWeek values. 0, the default, shows alarms regardless of their weekdays.
+ */
+void AlarmFilterModel::setDaysOfWeekMask(int mask)
+{
+    mask &= AlarmObject::AllDays;
+    if (m_daysOfWeekMask == mask)
+        return;
+
+    m_daysOfWeekMask = mask;
+    updateCriterion(DaysOfWeekMatch);
+    emit daysOfWeekMaskChanged();
+}
+
+/*!
+ *  \qmlproperty int AlarmFilterModel::timeRangeStart
+ *  \qmlproperty int AlarmFilterModel::timeRangeEnd
+ *
+ *  Only show alarms whose time, in minutes since midnight, is from timeRangeStart
+ *  to timeRangeEnd inclusive. The range wraps over midnight if the start is after
+ *  the end. The range is not used while either is -1, the default.
+ */
+void AlarmFilterModel::setTimeRangeStart(int minutes)
+{
+    if (m_timeRangeStart == minutes)
+        return;
+
+    m_timeRangeStart = minutes;
+    updateCriterion(TimeMatch);
+    emit timeRangeChanged();
+}
+
+void AlarmFilterModel::setTimeRangeEnd(int minutes)
+{
+    if (m_timeRangeEnd == minutes)
+        return;
+
+    m_timeRangeEnd = minutes;
+    updateCriterion(TimeMatch);
+    emit timeRangeChanged();
+}
+
+/*!
+ *  \qmlproperty string AlarmFilterModel::notebookUid
+ *
+ *  Only show alarms of calendar events in this notebook. An empty string, the default,
+ *  shows all alarms.
+ */
+void AlarmFilterModel::setNotebookUid(const QString &uid)
+{
+    if (m_notebookUid == uid)
+        return;
+
+    m_notebookUid = uid;
+    updateCriterion(NotebookMatch);
+    emit notebookUidChanged();
+}
+
+/*!
+ *  \qmlproperty string AlarmFilterModel::titleFilter
+ *
+ *  Only show alarms whose title contains this string, ignoring case. An empty
+ *  string, the default, shows all alarms.
+ */
+void AlarmFilterModel::setTitleFilter(const QString &filter)
+{
+    if (m_titleFilter == filter)
+        return;
+
+    m_titleFilter = filter;
+    updateCriterion(TitleMatch);
+    emit titleFilterChanged();
+}
+
+bool AlarmFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    if (sourceParent.isValid() || sourceRow < 0 || sourceRow >= m_index.size())
+        return false;
+    return m_index.at(sourceRow) == AllMatch;
+}
+
+// Returns the bits of \a criteria that the alarm passes
+quint8 AlarmFilterModel::matches(const AlarmRecord *record, int criteria) const
+{
+    quint8 result = 0;
+
+    if (criteria & TypeMatch) {
+        if (m_alarmType < 0) {
+            result |= TypeMatch;
+        } else if (record->type == m_alarmType) {
+            result |= TypeMatch;
+        }
+    }
+
+    if ((criteria & EnabledMatch) && (m_enabledState == AnyState
+            || record->enabled == (m_enabledState == EnabledOnly)))
+        result |= EnabledMatch;
+
+    if ((criteria & DaysOfWeekMatch) && (!m_daysOfWeekMask || (record->daysOfWeek & m_daysOfWeekMask)))
+        result |= DaysOfWeekMatch;
+
+    if (criteria & TimeMatch) {
+        int time = record->hour * 60 + record->minute;
+        if (m_timeRangeStart < 0 || m_timeRangeEnd < 0)
+            result |= TimeMatch;
+        else if (m_timeRangeStart <= m_timeRangeEnd && time >= m_timeRangeStart && time <= m_timeRangeEnd)
+            result |= TimeMatch;
+        else if (m_timeRangeStart > m_timeRangeEnd && (time >= m_timeRangeStart || time <= m_timeRangeEnd))
+            result |= TimeMatch;
+    }
+
+    if ((criteria & NotebookMatch) && (m_notebookUid.isEmpty()
+            || record->notebookUid == m_notebookUid))
+        result |= NotebookMatch;
+
+    if ((criteria & TitleMatch) && (m_titleFilter.isEmpty()
+            || record->title.contains(m_titleFilter, Qt::CaseInsensitive)))
+        result |= TitleMatch;
+
+    return result;
+}
+
+// Check one criterion again for every alarm, then filter the rows by the index
+void AlarmFilterModel::updateCriterion(Criterion criterion)
+{
+    if (!m_model)
+        return;
+
+    for (int row = 0; row < m_index.size(); row++)
+        m_index[row] = (m_index[row] & ~criterion) | matches(m_model->record(row), criterion);
+    invalidateFilter();
+}
+
+void AlarmFilterModel::rebuildIndex()
+{
+    m_index.resize(m_model ? m_model->rowCount() : 0);
+    for (int row = 0; row < m_index.size(); row++)
+        m_index[row] = matches(m_model->record(row), AllMatch);
+}
+
+void AlarmFilterModel::sourceRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    if (parent.isValid())
+        return;
+
+    m_index.insert(first, last - first + 1, 0);
+    for (int row = first; row <= last; row++)
+        m_index[row] = matches(m_model->record(row), AllMatch);
+}
+
+void AlarmFilterModel::sourceRowsRemoved(const QModelIndex &parent, int first, int last)
+{
+    if (!parent.isValid())
+        m_index.remove(first, last - first + 1);
+}
+
+void AlarmFilterModel::sourceRowsMoved(const QModelIndex &parent, int start, int end, const QModelIndex &destination, int row)
+{
+    if (parent.isValid() || destination.isValid())
+        return;
+
+    QVector<quint8> moved = m_index.mid(start, end - start + 1);
+    m_index.remove(start, moved.size());
+    if (row > start)
+        row -= moved.size();
+    for (int i = 0; i < moved.size(); i++)
+        m_index.insert(row + i, moved.at(i));
+}
+
+void AlarmFilterModel::sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    for (int row = topLeft.row(); row <= bottomRight.row() && row < m_index.size(); row++)
+        m_index[row] = matches(m_model->record(row), AllMatch);
+}
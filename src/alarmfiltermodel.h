@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#ifndef ALARMFILTERMODEL_H
+#define ALARMFILTERMODEL_H
+
+#include <QPointer>
+#include <QSortFilterProxyModel>
+#include <QVector>
+#include <QtQml>
+
+struct AlarmRecord;
+class AlarmsBackendModel;
+
+class AlarmFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+    Q_ENUMS(EnabledState)
+    Q_PROPERTY(QObject *model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(int alarmType READ alarmType WRITE setAlarmType NOTIFY alarmTypeChanged)
+    Q_PROPERTY(int enabledState READ enabledState WRITE setEnabledState NOTIFY enabledStateChanged)
+    Q_PROPERTY(int daysOfWeekMask READ daysOfWeekMask WRITE setDaysOfWeekMask NOTIFY daysOfWeekMaskChanged)
+    Q_PROPERTY(int timeRangeStart READ timeRangeStart WRITE setTimeRangeStart NOTIFY timeRangeChanged)
+    Q_PROPERTY(int timeRangeEnd READ timeRangeEnd WRITE setTimeRangeEnd NOTIFY timeRangeChanged)
+    Q_PROPERTY(QString notebookUid READ notebookUid WRITE setNotebookUid NOTIFY notebookUidChanged)
+    Q_PROPERTY(QString titleFilter READ titleFilter WRITE setTitleFilter NOTIFY titleFilterChanged)
+
+public:
+    enum EnabledState {
+        AnyState,
+        EnabledOnly,
+        DisabledOnly
+    };
+
+    AlarmFilterModel(QObject *parent = 0);
+
+    QObject *model() const;
+    void setModel(QObject *model);
+    void setSourceModel(QAbstractItemModel *sourceModel);
+
+    int alarmType() const { return m_alarmType; }
+    void setAlarmType(int type);
+
+    int enabledState() const { return m_enabledState; }
+    void setEnabledState(int state);
+
+    int daysOfWeekMask() const { return m_daysOfWeekMask; }
+    void setDaysOfWeekMask(int mask);
+
+    int timeRangeStart() const { return m_timeRangeStart; }
+    void setTimeRangeStart(int minutes);
+    int timeRangeEnd() const { return m_timeRangeEnd; }
+    void setTimeRangeEnd(int minutes);
+
+    QString notebookUid() const { return m_notebookUid; }
+    void setNotebookUid(const QString &uid);
+
+    QString titleFilter() const { return m_titleFilter; }
+    void setTitleFilter(const QString &filter);
+
+signals:
+    void modelChanged();
+    void alarmTypeChanged();
+    void enabledStateChanged();
+    void daysOfWeekMaskChanged();
+    void timeRangeChanged();
+    void notebookUidChanged();
+    void titleFilterChanged();
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const;
+
+private slots:
+    void sourceRowsInserted(const QModelIndex &parent, int first, int last);
+    void sourceRowsRemoved(const QModelIndex &parent, int first, int last);
+    void sourceRowsMoved(const QModelIndex &parent, int start, int end, const QModelIndex &destination, int row);
+    void sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void rebuildIndex();
+
+private:
+    // One bit per criterion, set when the alarm passes it or the criterion is not in use
+    enum Criterion {
+        TypeMatch = 0x01,
+        EnabledMatch = 0x02,
+        DaysOfWeekMatch = 0x04,
+        TimeMatch = 0x08,
+        NotebookMatch = 0x10,
+        TitleMatch = 0x20,
+        AllMatch = 0x3f
+    };
+
+    quint8 matches(const AlarmRecord *record, int criteria) const;
+    void updateCriterion(Criterion criterion);
+
+    QPointer<AlarmsBackendModel> m_model;
+    // Criteria passed by each source row, kept in step with the source rows
+    QVector<quint8> m_index;
+
+    int m_alarmType;
+    int m_enabledState;
+    int m_daysOfWeekMask;
+    int m_timeRangeStart;
+    int m_timeRangeEnd;
+    QString m_notebookUid;
+    QString m_titleFilter;
+};
+
+QML_DECLARE_TYPE(AlarmFilterModel)
+
+#endif // ALARMFILTERMODEL_H
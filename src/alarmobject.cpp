@@ -31,7 +31,10 @@
  */
 
 #include "alarmobject.h"
+#include "alarmattributes.h"
+#include "alarmstore.h"
 #include "interface.h"
+#include "countdownticker.h"
 #include <QDBusPendingReply>
 #include <QDebug>
 
@@ -43,6 +46,50 @@
 #include <timed-qt5/exception>
 #endif
 
+// Characters of the daysOfWeek string for the mask bits 0 (Monday) through 6 (Sunday)
+static const char weekdayChars[] = "mtwTfsS";
+
+// Weekdays in the order used for sorting, as bits 6 (Monday) through 0 (Sunday)
+static int daysOfWeekSortBits(int mask)
+{
+    int bits = 0;
+    for (int day = 0; day < 7; day++) {
+        if (mask & (1 << day))
+            bits |= 1 << (6 - day);
+    }
+    return bits;
+}
+
+// Returns the mask for a daysOfWeek string, or -1 if it contains other characters
+int AlarmObject::parseDaysOfWeek(const QString &days)
+{
+    int mask = 0;
+    for (int i = 0; i < days.size(); i++) {
+        switch (days[i].toLatin1()) {
+            case 'm': mask |= Monday; break;
+            case 't': mask |= Tuesday; break;
+            case 'w': mask |= Wednesday; break;
+            case 'T': mask |= Thursday; break;
+            case 'f': mask |= Friday; break;
+            case 's': mask |= Saturday; break;
+            case 'S': mask |= Sunday; break;
+            default:
+                return -1;
+        }
+    }
+    return mask;
+}
+
+QString AlarmObject::formatDaysOfWeek(int mask)
+{
+    QString days;
+    for (int day = 0; day < 7; day++) {
+        if (mask & (1 << day))
+            days.append(QLatin1Char(weekdayChars[day]));
+    }
+    return days;
+}
+
 /*!
  *  \qmlproperty string Alarm::title
  *
@@ -89,6 +136,21 @@
  *  By default (when this property is empty), alarms are single-shot: they trigger
  *  at the specified time in the next day, and then are disabled and won't trigger
  *  again unless enabled again.
+ *
+ *  The days are returned in the order Monday through Sunday, regardless of the
+ *  order in which they were set.
+ *
+ *  \sa daysOfWeekMask
+ */
+
+/*!
+ *  \qmlproperty int Alarm::daysOfWeekMask
+ *  Weekdays when the alarm will be repeated, as a combination of flags
+ *
+ *  The same days as daysOfWeek, with Alarm.Monday (0x01) through Alarm.Sunday (0x40)
+ *  set for each day. 0 for a single-shot alarm.
+ *
+ *  \sa daysOfWeek
  */
 
 /*!
@@ -127,10 +189,48 @@
  *  Indicates the trigger time in seconds since Unix epoch. Valid only for
  *  countdown alarms. The remaining time for an countdown alarm can be
  *  calculated \a triggerTime - now - \a elapsed, where now is the current
- *  time expressed as seconds since the Unix epoch.
+ *  time expressed as seconds since the Unix epoch, and is readily available
+ *  as \a remaining.
  *
  *  \sa countdown
  *  \sa elapsed
+ *  \sa remaining
+ */
+
+/*!
+ *  \qmlproperty datetime Alarm::nextOccurrence
+ *
+ *  The next time at which the alarm goes off, in local time. For clock alarms this
+ *  is the next time of day \a hour:\a minute:\a second on one of the \a daysOfWeek,
+ *  or within the next day if no days are set, regardless of \a enabled. For countdown
+ *  alarms it is the \a triggerTime while the alarm is running, and invalid otherwise.
+ *
+ *  The value is computed when first read, and follows the alarm as it is edited, as
+ *  well as changes to the system time and the timezone.
+ *
+ *  \sa triggerTime
+ */
+
+/*!
+ *  \qmlproperty int Alarm::nextTriggerTime
+ *
+ *  The time at which timed triggers the alarm next, in seconds since the Unix epoch,
+ *  or 0 if the alarm is not scheduled. This is the time timed reports, including
+ *  snoozes, and is known only for alarms of an AlarmsModel.
+ *
+ *  \sa nextOccurrence
+ */
+
+/*!
+ *  \qmlproperty int Alarm::remaining
+ *
+ *  The time left of a countdown alarm in seconds, 0 for other alarms. While the
+ *  countdown is running, this is updated every second. The updates of all alarms
+ *  are aligned to the seconds of the wall clock and driven by a single timer,
+ *  which only runs while a countdown is.
+ *
+ *  \sa triggerTime
+ *  \sa elapsed
  */
 
 /*!
@@ -200,67 +300,205 @@
  */
 
 AlarmObject::AlarmObject(QObject *parent)
-    : QObject(parent), m_hour(0), m_minute(0), m_second(0), m_enabled(false),
+    : QObject(parent), m_hour(0), m_minute(0), m_second(0), m_daysOfWeek(0), m_enabled(false),
       m_createdDate(QDateTime::currentDateTime()), m_countdown(false), m_reminder(false), m_triggerTime(0),
-      m_elapsed(0), m_cookie(0), m_timeoutSnoozeCounter(0), m_maximalTimeoutSnoozeCount(0)
+      m_elapsed(0), m_cookie(0), m_timeoutSnoozeCounter(0), m_maximalTimeoutSnoozeCount(0),
+      m_dirty(AllDirty), m_savingDirty(0), m_saveGeneration(0), m_saveInFlight(false), m_saveQueued(false),
+      m_nextOccurrenceValid(false), m_nextTriggerTime(0), m_remaining(0), m_ticking(false)
 {
+    updateSortKey();
+    m_acknowledged = persistedValues();
+    updateRemaining();
 }
 
 AlarmObject::AlarmObject(const QMap<QString,QString> &data, QObject *parent)
-    : QObject(parent), m_hour(0), m_minute(0), m_second(0), m_enabled(false),
+    : QObject(parent), m_hour(0), m_minute(0), m_second(0), m_daysOfWeek(0), m_enabled(false),
       m_createdDate(QDateTime::currentDateTime()), m_countdown(false), m_reminder(false), m_triggerTime(0),
-      m_elapsed(0), m_cookie(0)
+      m_elapsed(0), m_cookie(0), m_timeoutSnoozeCounter(0), m_maximalTimeoutSnoozeCount(0),
+      m_dirty(0), m_savingDirty(0), m_saveGeneration(0), m_saveInFlight(false), m_saveQueued(false),
+      m_nextOccurrenceValid(false), m_nextTriggerTime(0), m_remaining(0), m_ticking(false)
+{
+    loadAttributes(data);
+    updateSortKey();
+    updateRemaining();
+}
+
+AlarmObject::~AlarmObject()
+{
+    if (m_ticking)
+        CountdownTicker::instance()->release();
+}
+
+// Replace the state of the object with timed attributes, emitting change signals
+// for the properties that differ. Unlike save(), this does not emit updated(); the
+// caller is responsible for repositioning the alarm in its model. Objects with edits
+// that are not saved yet, or are being saved, are left alone: the save brings timed
+// in line with them.
+bool AlarmObject::reload(const QMap<QString,QString> &data)
+{
+    if (hasLocalChanges())
+        return false;
+
+    const QString oldTitle = m_title;
+    const int oldTime = m_hour * 3600 + m_minute * 60 + m_second;
+    const int oldDaysOfWeek = m_daysOfWeek;
+    const bool oldEnabled = m_enabled;
+    const QDateTime oldCreatedDate = m_createdDate;
+    const bool oldCountdown = m_countdown;
+    const int oldType = type();
+    const qint64 oldTriggerTime = m_triggerTime;
+    const qint64 oldElapsed = m_elapsed;
+    const unsigned oldCookie = m_cookie;
+    const int oldMaximalTimeoutSnoozeCount = m_maximalTimeoutSnoozeCount;
+
+    m_title.clear();
+    m_hour = m_minute = m_second = 0;
+    m_daysOfWeek = 0;
+    m_enabled = false;
+    m_countdown = false;
+    m_reminder = false;
+    m_triggerTime = 0;
+    m_elapsed = 0;
+    m_startDate = m_endDate = QDateTime();
+    m_startDateText.clear();
+    m_endDateText.clear();
+    m_uid.clear();
+    m_recurrenceId.clear();
+    m_notebookUid.clear();
+    m_phoneNumber.clear();
+    m_timeoutSnoozeCounter = 0;
+    m_maximalTimeoutSnoozeCount = 0;
+
+    loadAttributes(data);
+    updateSortKey();
+
+    bool changed = false;
+    if (m_title != oldTitle) {
+        emit titleChanged();
+        changed = true;
+    }
+    if (m_hour * 3600 + m_minute * 60 + m_second != oldTime) {
+        emit timeChanged();
+        changed = true;
+    }
+    if (m_daysOfWeek != oldDaysOfWeek) {
+        emit daysOfWeekChanged();
+        changed = true;
+    }
+    if (m_enabled != oldEnabled) {
+        emit enabledChanged();
+        changed = true;
+    }
+    if (m_createdDate != oldCreatedDate)
+        changed = true;
+    if (m_countdown != oldCountdown) {
+        emit countdownChanged();
+        changed = true;
+    }
+    if (type() != oldType) {
+        emit typeChanged();
+        changed = true;
+    }
+    if (m_triggerTime != oldTriggerTime) {
+        emit triggerTimeChanged();
+        changed = true;
+    }
+    if (m_elapsed != oldElapsed) {
+        emit elapsedChanged();
+        changed = true;
+    }
+    if (m_cookie != oldCookie) {
+        emit idChanged();
+        changed = true;
+    }
+    if (m_maximalTimeoutSnoozeCount != oldMaximalTimeoutSnoozeCount) {
+        emit maximalTimeoutSnoozeCountChanged();
+        changed = true;
+    }
+    if (changed)
+        updateComputedProperties();
+
+    return changed;
+}
+
+void AlarmObject::loadAttributes(const QMap<QString,QString> &data)
 {
     for (QMap<QString,QString>::ConstIterator it = data.begin(); it != data.end(); it++) {
-        if (it.key() == "TITLE") {
-            setTitle(it.value());
-        } else if (it.key() == "COOKIE") {
-            m_cookie = it.value().toUInt();
-        } else if (it.key() == "daysOfWeek") {
-            setDaysOfWeek(it.value());
-        } else if (it.key() == "createdDate") {
-            // Try first to convert date from string, previous versions stored createdDate as a
-            // stringified QDateTime, which caused problems whith different locales.
-            m_createdDate = QDateTime::fromString(it.value());
-            if (!m_createdDate.isValid())
-                m_createdDate = QDateTime::fromMSecsSinceEpoch(it.value().toLongLong());
-        } else if (it.key() == "elapsed") {
-            m_elapsed = it.value().toInt();
-        } else if (it.key() == "timeOfDayWithSeconds") { // new format with seconds support
-            int value = it.value().toInt();
+        switch (AlarmAttributes::key(it.key())) {
+        case AlarmAttributes::Title:
+            m_title = it.value();
+            break;
+        case AlarmAttributes::Cookie:
+            m_cookie = AlarmAttributes::toInteger(it.value());
+            break;
+        case AlarmAttributes::DaysOfWeek: {
+            int mask = parseDaysOfWeek(it.value());
+            if (mask >= 0)
+                m_daysOfWeek = mask;
+            else
+                qWarning() << Q_FUNC_INFO << "Invalid input string:" << it.value();
+            break;
+        }
+        case AlarmAttributes::CreatedDate:
+            m_createdDate = QDateTime::fromMSecsSinceEpoch(AlarmAttributes::toCreatedMSecs(it.value()));
+            break;
+        case AlarmAttributes::Elapsed:
+            m_elapsed = AlarmAttributes::toInteger(it.value());
+            break;
+        case AlarmAttributes::TimeOfDayWithSeconds: { // new format with seconds support
+            int value = AlarmAttributes::toInteger(it.value());
             m_hour = value / 3600;
             m_minute = (value % 3600) / 60;
             m_second = value % 60;
-        } else if (it.key() == "timeOfDay") { // old format
-            int value = it.value().toInt();
+            break;
+        }
+        case AlarmAttributes::TimeOfDay: { // old format
+            int value = AlarmAttributes::toInteger(it.value());
             m_hour = value / 60;
             m_minute = value % 60;
-        } else if (it.key() == "STATE") {
-            if (it.value() == "TRANQUIL" || it.value() == "WAITING")
+            break;
+        }
+        case AlarmAttributes::State:
+            if (it.value() == QLatin1String("TRANQUIL") || it.value() == QLatin1String("WAITING"))
                 m_enabled = false;
             else
                 m_enabled = true;
-        } else if (it.key() == "triggerTime") {
+            break;
+        case AlarmAttributes::TriggerTime:
             m_countdown = true;
-            m_triggerTime = it.value().toUInt();
-        } else if (it.key() == "startDate") {
-            m_startDate = QDateTime::fromString(it.value(), Qt::ISODate);
-        } else if (it.key() == "endDate") {
-            m_endDate = QDateTime::fromString(it.value(), Qt::ISODate);
-        } else if (it.key() == "uid") {
+            m_triggerTime = AlarmAttributes::toInteger(it.value());
+            break;
+        case AlarmAttributes::StartDate:
+            // Parsed when first asked for, most alarms never are
+            m_startDateText = it.value();
+            break;
+        case AlarmAttributes::EndDate:
+            m_endDateText = it.value();
+            break;
+        case AlarmAttributes::Uid:
             m_uid = it.value();
-        } else if (it.key() == "recurrenceId") {
+            break;
+        case AlarmAttributes::RecurrenceId:
             m_recurrenceId = it.value();
-        } else if (it.key() == "timeoutSnoozeCounter") {
-            m_timeoutSnoozeCounter = it.value().toUInt();
-        } else if (it.key() == "maximalTimeoutSnoozeCounter") {
-            m_maximalTimeoutSnoozeCount = it.value().toInt();
-        } else if (it.key() == "notebook") {
+            break;
+        case AlarmAttributes::TimeoutSnoozeCounter:
+            m_timeoutSnoozeCounter = AlarmAttributes::toInteger(it.value());
+            break;
+        case AlarmAttributes::MaximalTimeoutSnoozeCounter:
+            m_maximalTimeoutSnoozeCount = AlarmAttributes::toInteger(it.value());
+            break;
+        case AlarmAttributes::Notebook:
             m_notebookUid = it.value();
-        } else if (it.key() == QLatin1String("phoneNumber")) {
+            break;
+        case AlarmAttributes::PhoneNumber:
             m_phoneNumber = it.value();
-        } else if (it.key() == QLatin1String("type") && it.value() == QLatin1String("reminder")) {
-            m_reminder = true;
+            break;
+        case AlarmAttributes::Type:
+            if (it.value() == QLatin1String("reminder"))
+                m_reminder = true;
+            break;
+        case AlarmAttributes::Unknown:
+            break;
         }
     }
 
@@ -273,6 +511,142 @@ AlarmObject::AlarmObject(const QMap<QString,QString> &data, QObject *parent)
 #endif
         m_elapsed = m_triggerTime - now;
     }
+
+    m_acknowledged = persistedValues();
+}
+
+// The sort key packs, from the most significant bits: the time of day in minutes (14 bits),
+// the weekdays (7 bits) and the creation time in milliseconds since the epoch (43 bits).
+// Alarms with equal keys are ordered by title.
+quint64 AlarmObject::makeSortKey(int hour, int minute, int daysOfWeekMask, qint64 createdMSecs)
+{
+    const quint64 minutes = qBound(0, hour * 60 + minute, (1 << 14) - 1);
+    const quint64 days = daysOfWeekSortBits(daysOfWeekMask);
+    const quint64 created = qBound(Q_INT64_C(0), createdMSecs, (Q_INT64_C(1) << 43) - 1);
+
+    return (minutes << 50) | (days << 43) | created;
+}
+
+void AlarmObject::updateSortKey()
+{
+    m_sortKey = makeSortKey(m_hour, m_minute, m_daysOfWeek, m_createdDate.toMSecsSinceEpoch());
+}
+
+// The first time of day on one of the days in the mask that is later than \a from, in
+// local time. An empty mask is a one-shot alarm, which goes off within a day as well.
+QDateTime AlarmObject::calculateNextOccurrence(int hour, int minute, int second, int daysOfWeekMask,
+                                               const QDateTime &from)
+{
+    const QTime time(hour, minute, second);
+    if (!time.isValid())
+        return QDateTime();
+
+    const int mask = (daysOfWeekMask & AllDays) ? (daysOfWeekMask & AllDays) : AllDays;
+    const QDate today = from.date();
+    // Up to a week ahead, as the time may have passed already on today's weekday
+    for (int day = 0; day <= 7; day++) {
+        const QDate date = today.addDays(day);
+        if (!(mask & (1 << (date.dayOfWeek() - 1))))
+            continue;
+
+        const QDateTime occurrence(date, time);
+        if (occurrence > from)
+            return occurrence;
+    }
+
+    return QDateTime();
+}
+
+void AlarmObject::setNextTriggerTime(uint triggerTime)
+{
+    if (m_nextTriggerTime == triggerTime)
+        return;
+
+    m_nextTriggerTime = triggerTime;
+    emit nextTriggerTimeChanged();
+}
+
+// Seconds left of a countdown of \a duration seconds: until \a triggerMSecs while it runs,
+// otherwise what remains after \a elapsed. Rounded to the nearest second, so that ticks
+// arriving slightly early or late still count down one second at a time.
+int AlarmObject::calculateRemaining(int duration, qint64 triggerMSecs, qint64 elapsed, qint64 nowMSecs)
+{
+    if (triggerMSecs > 0)
+        return int(qMax(Q_INT64_C(0), qRound64((triggerMSecs - nowMSecs) / 1000.0)));
+    return int(qMax(Q_INT64_C(0), duration - elapsed));
+}
+
+int AlarmObject::remainingAt(qint64 nowMSecs) const
+{
+    if (!m_countdown)
+        return 0;
+
+    const bool running = m_enabled && m_triggerTime > 0;
+    return calculateRemaining(m_hour * 3600 + m_minute * 60 + m_second,
+                              running ? qint64(m_triggerTime) * 1000 : 0, m_elapsed, nowMSecs);
+}
+
+void AlarmObject::updateRemaining()
+{
+    const int remaining = remainingAt(QDateTime::currentMSecsSinceEpoch());
+
+    // Nothing changes any more once the countdown has run out
+    const bool ticking = m_countdown && m_enabled && m_triggerTime > 0 && remaining > 0;
+    if (ticking != m_ticking) {
+        CountdownTicker *ticker = CountdownTicker::instance();
+        m_ticking = ticking;
+        if (ticking) {
+            connect(ticker, SIGNAL(tick()), this, SLOT(updateRemaining()));
+            ticker->acquire();
+        } else {
+            disconnect(ticker, SIGNAL(tick()), this, SLOT(updateRemaining()));
+            ticker->release();
+        }
+    }
+
+    if (remaining != m_remaining) {
+        m_remaining = remaining;
+        emit remainingChanged();
+    }
+}
+
+// Computed on first read and kept until it is invalidated
+QDateTime AlarmObject::nextOccurrence() const
+{
+    if (m_nextOccurrenceValid)
+        return m_nextOccurrence;
+
+    m_nextOccurrence = QDateTime();
+    if (m_countdown) {
+        if (m_enabled && m_triggerTime > 0)
+            m_nextOccurrence = QDateTime::fromMSecsSinceEpoch(qint64(m_triggerTime) * 1000);
+    } else {
+        m_nextOccurrence = calculateNextOccurrence(m_hour, m_minute, m_second, m_daysOfWeek,
+                                                   QDateTime::currentDateTime());
+    }
+    m_nextOccurrenceValid = true;
+
+    // Someone relies on it now, it has to be refreshed once it has passed
+    if (m_nextOccurrence.isValid())
+        AlarmStore::occurrenceComputed(m_nextOccurrence.toMSecsSinceEpoch());
+    return m_nextOccurrence;
+}
+
+// Forget the next occurrence, notifying if it has been read
+void AlarmObject::invalidateNextOccurrence()
+{
+    if (!m_nextOccurrenceValid)
+        return;
+
+    m_nextOccurrenceValid = false;
+    emit nextOccurrenceChanged();
+}
+
+// The time, days, state or countdown of the alarm changed
+void AlarmObject::updateComputedProperties()
+{
+    invalidateNextOccurrence();
+    updateRemaining();
 }
 
 void AlarmObject::setTitle(const QString &t)
@@ -281,6 +655,7 @@ void AlarmObject::setTitle(const QString &t)
         return;
 
     m_title = t;
+    updateDirty(TitleDirty);
     emit titleChanged();
 }
 
@@ -290,7 +665,10 @@ void AlarmObject::setHour(int hour)
         return;
 
     m_hour = hour;
+    updateSortKey();
+    updateDirty(TimeDirty);
     emit timeChanged();
+    updateComputedProperties();
 }
 
 void AlarmObject::setMinute(int minute)
@@ -299,7 +677,10 @@ void AlarmObject::setMinute(int minute)
         return;
 
     m_minute = minute;
+    updateSortKey();
+    updateDirty(TimeDirty);
     emit timeChanged();
+    updateComputedProperties();
 }
 
 void AlarmObject::setSecond(int second)
@@ -308,31 +689,33 @@ void AlarmObject::setSecond(int second)
         return;
 
     m_second = second;
+    updateDirty(TimeDirty);
     emit timeChanged();
+    updateComputedProperties();
 }
 
 void AlarmObject::setDaysOfWeek(const QString &in) 
 {
-    QString str;
-    for (int i = 0; i < in.size(); i++) {
-        switch (in[i].toLatin1()) {
-            case 'm':
-            case 't':
-            case 'w':
-            case 'T':
-            case 'f':
-            case 's':
-            case 'S':
-                str += in[i];
-                break;
-            default:
-                qWarning() << Q_FUNC_INFO << "Invalid input string:" << in;
-                return;
-        }
+    int mask = parseDaysOfWeek(in);
+    if (mask < 0) {
+        qWarning() << Q_FUNC_INFO << "Invalid input string:" << in;
+        return;
     }
 
-    m_daysOfWeek = str;
+    setDaysOfWeekMask(mask);
+}
+
+void AlarmObject::setDaysOfWeekMask(int mask)
+{
+    mask &= AllDays;
+    if (m_daysOfWeek == mask)
+        return;
+
+    m_daysOfWeek = mask;
+    updateSortKey();
+    updateDirty(DaysOfWeekDirty);
     emit daysOfWeekChanged();
+    invalidateNextOccurrence();
 }
 
 void AlarmObject::setEnabled(bool enabled)
@@ -340,8 +723,24 @@ void AlarmObject::setEnabled(bool enabled)
     if (m_enabled == enabled)
         return;
 
+    m_enabled = enabled;
+    updateDirty(EnabledDirty);
+    emit enabledChanged();
+    updateComputedProperties();
+    emit updated();
+}
+
+// Change the enabled state without marking it for saving, for state changes that
+// come from the backend
+void AlarmObject::setEnabledState(bool enabled)
+{
+    m_acknowledged.enabled = enabled;
+    if (m_enabled == enabled)
+        return;
+
     m_enabled = enabled;
     emit enabledChanged();
+    updateComputedProperties();
     emit updated();
 }
 
@@ -351,7 +750,9 @@ void AlarmObject::setCountdown(bool countdown)
         return;
 
     m_countdown = countdown;
+    updateDirty(CountdownDirty);
     emit countdownChanged();
+    updateComputedProperties();
     emit typeChanged();
 }
 
@@ -368,7 +769,7 @@ int AlarmObject::type() const
 {
     if (m_reminder)
         return Reminder;
-    else if (m_startDate.isValid() && m_endDate.isValid())
+    else if (startDate().isValid() && endDate().isValid())
         return Calendar;
     else if (m_countdown)
         return Countdown;
@@ -385,6 +786,10 @@ int AlarmObject::type() const
   */
 QDateTime AlarmObject::startDate() const
 {
+    if (!m_startDateText.isEmpty()) {
+        m_startDate = QDateTime::fromString(m_startDateText, Qt::ISODate);
+        m_startDateText.clear();
+    }
     return m_startDate;
 }
 
@@ -397,6 +802,10 @@ QDateTime AlarmObject::startDate() const
   */
 QDateTime AlarmObject::endDate() const
 {
+    if (!m_endDateText.isEmpty()) {
+        m_endDate = QDateTime::fromString(m_endDateText, Qt::ISODate);
+        m_endDateText.clear();
+    }
     return m_endDate;
 }
 
@@ -409,7 +818,7 @@ QDateTime AlarmObject::endDate() const
   */
 bool AlarmObject::allDay() const
 {
-    if (!m_startDate.isValid() || !m_endDate.isValid())
+    if (!startDate().isValid() || !endDate().isValid())
         return false;
 
     QTime start = m_startDate.time();
@@ -491,6 +900,7 @@ void AlarmObject::setMaximalTimeoutSnoozeCount(int count)
         return;
 
     m_maximalTimeoutSnoozeCount = count;
+    updateDirty(SnoozeDirty);
     emit maximalTimeoutSnoozeCountChanged();
 }
 
@@ -505,6 +915,16 @@ void AlarmObject::setMaximalTimeoutSnoozeCount(int count)
  *  \sa elapsed
  */
 void AlarmObject::reset()
+{
+    if (!m_countdown)
+        return;
+
+    if (m_elapsed || m_triggerTime)
+        markDirty(ElapsedDirty);
+    resetState();
+}
+
+void AlarmObject::resetState()
 {
     if (!m_countdown)
         return;
@@ -513,6 +933,7 @@ void AlarmObject::reset()
     m_triggerTime = 0;
     emit elapsedChanged();
     emit triggerTimeChanged();
+    updateComputedProperties();
 }
 
 
@@ -522,115 +943,254 @@ void AlarmObject::reset()
  *  Commit changes to the object to the backend. No modifications, including \a enabled,
  *  take effect until this method is called.
  *
- *  \sa updated, saved
+ *  Does nothing if the alarm has been saved before and has not been modified since.
+ *  While a save is in progress, further calls are combined into a single save that
+ *  is made once the first one has completed.
+ *
+ *  \sa updated, saved, dirty, forceSave()
  */
 void AlarmObject::save()
 {
+    if (m_cookie && !m_dirty)
+        return;
+
+    forceSave();
+}
+
+/*!
+ *  \qmlmethod void Alarm::forceSave()
+ *
+ *  Commit the object to the backend like save(), even if it has not been modified.
+ *
+ *  \sa save()
+ */
+void AlarmObject::forceSave()
+{
+    if (m_saveInFlight) {
+        // Writing again before the reply would race over the cookie, as timed replaces
+        // an event by creating a new one. Send the latest state once the write completes.
+        m_saveQueued = true;
+        emit updated();
+        return;
+    }
+
     try {
         Maemo::Timed::Event ev;
-        // Keep the event after it has triggered
-        ev.setKeepAliveFlag();
-        // Trigger the voland alarm/reminder dialog
-        ev.setReminderFlag();
-        if (!m_title.isEmpty())
-            ev.setAttribute(QLatin1String("TITLE"), m_title);
-
-        ev.setAttribute(QLatin1String("timeOfDayWithSeconds"),
-                        QString::number(m_hour * 3600 + m_minute * 60 + m_second));
-
-        ev.setAttribute(QLatin1String("APPLICATION"), QLatin1String("nemoalarms"));
-        ev.setAttribute(QLatin1String("createdDate"), QString::number(m_createdDate.toMSecsSinceEpoch()));
-        ev.setAlarmFlag();
-
-        if (!m_countdown) {
-            ev.setBootFlag();
-            ev.setMaximalTimeoutSnoozeCounter(m_maximalTimeoutSnoozeCount);
-
-            if (!m_daysOfWeek.isEmpty())
-                ev.setAttribute(QLatin1String("daysOfWeek"), m_daysOfWeek);
-
-            if (m_enabled) {
-                Maemo::Timed::Event::Recurrence rec = ev.addRecurrence();
-
-                rec.addHour(m_hour);
-                rec.addMinute(m_minute);
-                rec.everyDayOfMonth();
-                rec.everyMonth();
-
-                // Single-shot alarms are done with a recurrence and the single-shot
-                // flag, which removes recurrence information after the first trigger.
-                if (m_daysOfWeek.isEmpty()) {
-                    rec.everyDayOfWeek();
-                    ev.setSingleShotFlag();
-                }
-
-                // Map characters to numeric weekdays used by libtimed
-                QString weekdayMap(QLatin1String("SmtwTfs"));
-                for (int i = 0; i < m_daysOfWeek.size(); i++) {
-                    int day = weekdayMap.indexOf(m_daysOfWeek[i]);
-                    if (day >= 0)
-                        rec.addDayOfWeek(day);
-                }
+        fillEvent(ev);
+
+        // The store completes the write, even if this object is gone by then
+        AlarmStore *store = AlarmStore::acquire();
+        store->save(this, ev);
+        store->release();
+
+        // Emit the updated signal immediately to update UI
+        emit updated();
+    } catch (Maemo::Timed::Exception &e) {
+        qWarning() << "Nemo.Alarms: Cannot sync alarm to timed:" << e.what();
+    }
+}
+
+// Describe the alarm as a timed event. For countdown alarms this also updates triggerTime
+// and elapsed for the new state. Throws Maemo::Timed::Exception on failure.
+void AlarmObject::fillEvent(Maemo::Timed::Event &ev)
+{
+    // Keep the event after it has triggered
+    ev.setKeepAliveFlag();
+    // Trigger the voland alarm/reminder dialog
+    ev.setReminderFlag();
+    if (!m_title.isEmpty())
+        ev.setAttribute(QLatin1String("TITLE"), m_title);
+
+    ev.setAttribute(QLatin1String("timeOfDayWithSeconds"),
+                    QString::number(m_hour * 3600 + m_minute * 60 + m_second));
+
+    ev.setAttribute(QLatin1String("APPLICATION"), QLatin1String("nemoalarms"));
+    ev.setAttribute(QLatin1String("createdDate"), QString::number(m_createdDate.toMSecsSinceEpoch()));
+    ev.setAlarmFlag();
+
+    if (!m_countdown) {
+        ev.setBootFlag();
+        ev.setMaximalTimeoutSnoozeCounter(m_maximalTimeoutSnoozeCount);
+
+        if (m_daysOfWeek)
+            ev.setAttribute(QLatin1String("daysOfWeek"), formatDaysOfWeek(m_daysOfWeek));
+
+        if (m_enabled) {
+            Maemo::Timed::Event::Recurrence rec = ev.addRecurrence();
+
+            rec.addHour(m_hour);
+            rec.addMinute(m_minute);
+            rec.everyDayOfMonth();
+            rec.everyMonth();
+
+            // Single-shot alarms are done with a recurrence and the single-shot
+            // flag, which removes recurrence information after the first trigger.
+            if (!m_daysOfWeek) {
+                rec.everyDayOfWeek();
+                ev.setSingleShotFlag();
             }
-            ev.setAttribute(QLatin1String("type"), QLatin1String("clock"));
-        } else {
-            uint duration = m_hour * 3600 + m_minute * 60 + m_second;
-            QDateTime now = QDateTime::currentDateTimeUtc();
-            if (m_enabled) {
-                QDateTime triggerDateTime = now.addSecs(duration - m_elapsed);
+
+            // libtimed numbers weekdays from 0 (Sunday) to 6 (Saturday)
+            for (int day = 0; day < 7; day++) {
+                if (m_daysOfWeek & (1 << day))
+                    rec.addDayOfWeek((day + 1) % 7);
+            }
+        }
+        ev.setAttribute(QLatin1String("type"), QLatin1String("clock"));
+    } else {
+        uint duration = m_hour * 3600 + m_minute * 60 + m_second;
+        QDateTime now = QDateTime::currentDateTimeUtc();
+        if (m_enabled) {
+            QDateTime triggerDateTime = now.addSecs(duration - m_elapsed);
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-                m_triggerTime = triggerDateTime.toSecsSinceEpoch();
-                ev.setTicker(triggerDateTime.toSecsSinceEpoch());
+            m_triggerTime = triggerDateTime.toSecsSinceEpoch();
+            ev.setTicker(triggerDateTime.toSecsSinceEpoch());
 #else
-                m_triggerTime = triggerDateTime.toTime_t();
-                ev.setTicker(triggerDateTime.toTime_t());
+            m_triggerTime = triggerDateTime.toTime_t();
+            ev.setTicker(triggerDateTime.toTime_t());
 #endif
-            } else {
-                if (m_triggerTime > 0) {
+        } else {
+            if (m_triggerTime > 0) {
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-                    m_elapsed = (duration - (m_triggerTime - now.toSecsSinceEpoch()));
+                m_elapsed = (duration - (m_triggerTime - now.toSecsSinceEpoch()));
 #else
-                    m_elapsed = (duration - (m_triggerTime - now.toTime_t()));
+                m_elapsed = (duration - (m_triggerTime - now.toTime_t()));
 #endif
-                    m_triggerTime = 0;
-                } else {
-                    m_elapsed = 0;
-                }
-                emit elapsedChanged();
-                ev.setAttribute(QLatin1String("elapsed"), QString::number(m_elapsed));
+                m_triggerTime = 0;
+            } else {
+                m_elapsed = 0;
             }
-            emit triggerTimeChanged();
-            ev.setAttribute(QLatin1String("triggerTime"), QString::number(m_triggerTime));
-            ev.setAttribute(QLatin1String("type"), QLatin1String("countdown"));
+            emit elapsedChanged();
+            ev.setAttribute(QLatin1String("elapsed"), QString::number(m_elapsed));
         }
-
-        QDBusPendingCallWatcher *w;
-        if (m_cookie)
-            w = new QDBusPendingCallWatcher(TimedInterface::instance()->replace_event_async(ev, m_cookie), this);
-        else
-            w = new QDBusPendingCallWatcher(TimedInterface::instance()->add_event_async(ev), this);
-        connect(w, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(saveReply(QDBusPendingCallWatcher*)));
-
-        // Emit the updated signal immediately to update UI
-        emit updated();
-    } catch (Maemo::Timed::Exception &e) {
-        qWarning() << "Nemo.Alarms: Cannot sync alarm to timed:" << e.what();
+        emit triggerTimeChanged();
+        updateComputedProperties();
+        ev.setAttribute(QLatin1String("triggerTime"), QString::number(m_triggerTime));
+        ev.setAttribute(QLatin1String("type"), QLatin1String("countdown"));
     }
 }
 
-void AlarmObject::saveReply(QDBusPendingCallWatcher *w)
+/*!
+ *  \qmlproperty bool Alarm::dirty
+ *
+ *  True if the alarm has been modified since it was last loaded from or saved to
+ *  the backend, including while a save has not been confirmed yet. Changing a property
+ *  back to its saved value clears it.
+ *
+ *  \sa save()
+ */
+void AlarmObject::markDirty(int fields)
 {
-    QDBusPendingReply<uint> reply = *w;
-    w->deleteLater();
+    setDirtyFields(m_dirty | fields, m_savingDirty);
+}
 
-    if (reply.isError()) {
-        qWarning() << "Nemo.Alarms: Cannot sync alarm to timed:" << reply.error();
+// Mark a field as modified, or as clean again when it is back at the value timed last
+// confirmed. A field being written is compared with a value about to be replaced, it
+// stays modified until the reply. Alarms that were never saved are always modified.
+void AlarmObject::updateDirty(int field)
+{
+    if (!m_cookie || (m_savingDirty & field)) {
+        markDirty(field);
         return;
     }
 
-    m_cookie = reply.value();
+    const PersistedValues current = persistedValues();
+    bool reverted = false;
+    switch (field) {
+    case TitleDirty:
+        reverted = current.title == m_acknowledged.title;
+        break;
+    case TimeDirty:
+        reverted = current.time == m_acknowledged.time;
+        break;
+    case DaysOfWeekDirty:
+        reverted = current.daysOfWeek == m_acknowledged.daysOfWeek;
+        break;
+    case EnabledDirty:
+        reverted = current.enabled == m_acknowledged.enabled;
+        break;
+    case CountdownDirty:
+        reverted = current.countdown == m_acknowledged.countdown;
+        break;
+    case SnoozeDirty:
+        reverted = current.maximalTimeoutSnoozeCount == m_acknowledged.maximalTimeoutSnoozeCount;
+        break;
+    default:
+        break;
+    }
+
+    if (reverted)
+        setDirtyFields(m_dirty & ~field, m_savingDirty);
+    else
+        markDirty(field);
+}
+
+AlarmObject::PersistedValues AlarmObject::persistedValues() const
+{
+    PersistedValues values;
+    values.title = m_title;
+    values.time = m_hour * 3600 + m_minute * 60 + m_second;
+    values.daysOfWeek = m_daysOfWeek;
+    values.enabled = m_enabled;
+    values.countdown = m_countdown;
+    values.maximalTimeoutSnoozeCount = m_maximalTimeoutSnoozeCount;
+    return values;
+}
+
+// The modifications are being written, they stay dirty until the backend has
+// confirmed them. Returns the generation that the reply must be completed with.
+uint AlarmObject::beginSave()
+{
+    m_saveInFlight = true;
+    m_writing = persistedValues();
+    setDirtyFields(0, m_savingDirty | m_dirty);
+    return ++m_saveGeneration;
+}
+
+// Returns false if the write was superseded, in which case nothing is changed
+bool AlarmObject::setSaved(uint cookie, uint generation)
+{
+    if (generation != m_saveGeneration)
+        return false;
+
+    m_saveInFlight = false;
+    m_acknowledged = m_writing;
+    setDirtyFields(m_dirty, 0);
+    m_cookie = cookie;
     emit idChanged();
     emit saved();
+    saveQueued();
+    return true;
+}
+
+bool AlarmObject::setSaveFailed(uint generation)
+{
+    if (generation != m_saveGeneration)
+        return false;
+
+    m_saveInFlight = false;
+    setDirtyFields(m_dirty | m_savingDirty, 0);
+    saveQueued();
+    return true;
+}
+
+// Send the edits made while the previous write was in flight
+void AlarmObject::saveQueued()
+{
+    if (!m_saveQueued)
+        return;
+
+    m_saveQueued = false;
+    save();
+}
+
+void AlarmObject::setDirtyFields(int dirty, int savingDirty)
+{
+    bool wasDirty = isDirty();
+    m_dirty = dirty;
+    m_savingDirty = savingDirty;
+    if (isDirty() != wasDirty)
+        emit dirtyChanged();
 }
 
 
@@ -641,18 +1201,27 @@ void AlarmObject::saveReply(QDBusPendingCallWatcher *w)
  */
 void AlarmObject::deleteAlarm()
 {
-    if (!m_cookie) {
-        emit deleted();
-        return;
+    if (m_cookie) {
+        QDBusPendingCall re = TimedInterface::instance()->cancel_async(m_cookie);
+        QDBusPendingCallWatcher *w = new QDBusPendingCallWatcher(re, this);
+        connect(w, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(deleteReply(QDBusPendingCallWatcher*)));
     }
 
-    QDBusPendingCall re = TimedInterface::instance()->cancel_async(m_cookie);
-    QDBusPendingCallWatcher *w = new QDBusPendingCallWatcher(re, this);
-    connect(w, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(deleteReply(QDBusPendingCallWatcher*)));
+    setDeleted();
+}
+
+void AlarmObject::setDeleted()
+{
+    // Replies to writes still in flight are stale now
+    m_saveGeneration++;
+    m_saveInFlight = false;
+    m_saveQueued = false;
 
     emit deleted();
-    m_cookie = 0;
-    emit idChanged();
+    if (m_cookie) {
+        m_cookie = 0;
+        emit idChanged();
+    }
 }
 
 void AlarmObject::deleteReply(QDBusPendingCallWatcher *w)
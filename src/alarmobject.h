@@ -40,6 +40,12 @@
 class AlarmPrivate;
 class QDBusPendingCallWatcher;
 
+namespace Maemo {
+namespace Timed {
+class Event;
+}
+}
+
 class AlarmObject : public QObject
 {
     Q_OBJECT
@@ -48,12 +54,16 @@ class AlarmObject : public QObject
     Q_PROPERTY(int minute READ minute WRITE setMinute NOTIFY timeChanged)
     Q_PROPERTY(int second READ second WRITE setSecond NOTIFY timeChanged)
     Q_PROPERTY(QString daysOfWeek READ daysOfWeek WRITE setDaysOfWeek NOTIFY daysOfWeekChanged)
+    Q_PROPERTY(int daysOfWeekMask READ daysOfWeekMask WRITE setDaysOfWeekMask NOTIFY daysOfWeekChanged)
     Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
     Q_PROPERTY(int id READ id NOTIFY idChanged)
     Q_PROPERTY(QDateTime createdDate READ createdDate CONSTANT)
     Q_PROPERTY(bool countdown READ isCountdown WRITE setCountdown NOTIFY countdownChanged)
     Q_PROPERTY(uint triggerTime READ triggerTime NOTIFY triggerTimeChanged)
+    Q_PROPERTY(QDateTime nextOccurrence READ nextOccurrence NOTIFY nextOccurrenceChanged)
+    Q_PROPERTY(uint nextTriggerTime READ nextTriggerTime NOTIFY nextTriggerTimeChanged)
     Q_PROPERTY(int elapsed READ getElapsed NOTIFY elapsedChanged)
+    Q_PROPERTY(int remaining READ remaining NOTIFY remainingChanged)
     Q_PROPERTY(int type READ type NOTIFY typeChanged)
     Q_PROPERTY(QDateTime startDate READ startDate CONSTANT)
     Q_PROPERTY(QDateTime endDate READ endDate CONSTANT)
@@ -65,14 +75,30 @@ class AlarmObject : public QObject
     Q_PROPERTY(QString phoneNumber READ phoneNumber CONSTANT)
     Q_PROPERTY(int timeoutSnoozeCounter READ timeoutSnoozeCounter CONSTANT)
     Q_PROPERTY(int maximalTimeoutSnoozeCount READ maximalTimeoutSnoozeCount WRITE setMaximalTimeoutSnoozeCount NOTIFY maximalTimeoutSnoozeCountChanged)
+    Q_PROPERTY(bool dirty READ isDirty NOTIFY dirtyChanged)
 
 public:
     AlarmObject(QObject *parent = 0);
     AlarmObject(const QMap<QString,QString> &data, QObject *parent = 0);
+    ~AlarmObject();
+
+    bool reload(const QMap<QString,QString> &data);
 
     enum Type { Calendar, Clock, Countdown, Reminder };
     Q_ENUMS(Type)
 
+    enum DayOfWeek {
+        Monday = 0x01,
+        Tuesday = 0x02,
+        Wednesday = 0x04,
+        Thursday = 0x08,
+        Friday = 0x10,
+        Saturday = 0x20,
+        Sunday = 0x40,
+        AllDays = 0x7f
+    };
+    Q_ENUMS(DayOfWeek)
+
     QString title() const { return m_title; }
     void setTitle(const QString &title);
 
@@ -85,9 +111,15 @@ public:
     int second() const { return m_second; }
     void setSecond(int second);
 
-    QString daysOfWeek() const { return m_daysOfWeek; }
+    QString daysOfWeek() const { return formatDaysOfWeek(m_daysOfWeek); }
     void setDaysOfWeek(const QString &days);
 
+    int daysOfWeekMask() const { return m_daysOfWeek; }
+    void setDaysOfWeekMask(int mask);
+
+    static int parseDaysOfWeek(const QString &days);
+    static QString formatDaysOfWeek(int mask);
+
     bool isEnabled() const { return m_enabled; }
     void setEnabled(bool enabled);
 
@@ -95,17 +127,30 @@ public:
 
     QDateTime createdDate() const { return m_createdDate; }
 
+    quint64 sortKey() const { return m_sortKey; }
+    static quint64 makeSortKey(int hour, int minute, int daysOfWeekMask, qint64 createdMSecs);
+
     bool isCountdown() const { return m_countdown; }
     void setCountdown(bool countdown);
 
     uint triggerTime() const { return m_triggerTime; }
 
+    QDateTime nextOccurrence() const;
+
+    uint nextTriggerTime() const { return m_nextTriggerTime; }
+    static QDateTime calculateNextOccurrence(int hour, int minute, int second, int daysOfWeekMask,
+                                             const QDateTime &from);
+
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
     qint64 getElapsed() const { return m_elapsed; }
 #else
     int getElapsed() const { return m_elapsed; }
 #endif
 
+    int remaining() const { return m_remaining; }
+    int remainingAt(qint64 nowMSecs) const;
+    static int calculateRemaining(int duration, qint64 triggerMSecs, qint64 elapsed, qint64 nowMSecs);
+
     int type() const;
 
     QDateTime startDate() const;
@@ -129,8 +174,11 @@ public:
     int maximalTimeoutSnoozeCount() const;
     void setMaximalTimeoutSnoozeCount(int count);
 
+    bool isDirty() const { return m_dirty || m_savingDirty; }
+
     Q_INVOKABLE void reset();
     Q_INVOKABLE void save();
+    Q_INVOKABLE void forceSave();
     Q_INVOKABLE void deleteAlarm();
 
 signals:
@@ -141,22 +189,71 @@ signals:
     void idChanged();
     void countdownChanged();
     void triggerTimeChanged();
+    void nextOccurrenceChanged();
+    void nextTriggerTimeChanged();
     void elapsedChanged();
+    void remainingChanged();
     void typeChanged();
     void maximalTimeoutSnoozeCountChanged();
+    void dirtyChanged();
 
     void updated();
     void saved();
     void deleted();
 
 private slots:
-    void saveReply(QDBusPendingCallWatcher *w);
     void deleteReply(QDBusPendingCallWatcher *w);
+    void updateRemaining();
 
 protected:
+    // For saving and deleting several alarms at once
+    friend class AlarmStore;
+
+    // Persisted fields modified since the backend state was last known
+    enum DirtyField {
+        TitleDirty = 0x01,
+        TimeDirty = 0x02,
+        DaysOfWeekDirty = 0x04,
+        EnabledDirty = 0x08,
+        CountdownDirty = 0x10,
+        ElapsedDirty = 0x20,
+        SnoozeDirty = 0x40,
+        AllDirty = 0x7f
+    };
+
+    // The persisted values that edits can be reverted to
+    struct PersistedValues {
+        QString title;
+        int time;
+        int daysOfWeek;
+        bool enabled;
+        bool countdown;
+        int maximalTimeoutSnoozeCount;
+    };
+
+    void loadAttributes(const QMap<QString,QString> &data);
+    void updateSortKey();
+    void fillEvent(Maemo::Timed::Event &ev);
+    void setEnabledState(bool enabled);
+    void resetState();
+    void markDirty(int fields);
+    void updateDirty(int field);
+    PersistedValues persistedValues() const;
+    bool isSaving() const { return m_saveInFlight; }
+    bool hasLocalChanges() const { return m_dirty || m_savingDirty || m_saveInFlight || m_saveQueued; }
+    uint beginSave();
+    bool setSaved(uint cookie, uint generation);
+    bool setSaveFailed(uint generation);
+    void saveQueued();
+    void setDirtyFields(int dirty, int savingDirty);
+    void setDeleted();
+    void updateComputedProperties();
+    void invalidateNextOccurrence();
+    void setNextTriggerTime(uint triggerTime);
+
     QString m_title;
     int m_hour, m_minute, m_second;
-    QString m_daysOfWeek;
+    int m_daysOfWeek;
     bool m_enabled;
     QDateTime m_createdDate;
     bool m_countdown;
@@ -168,7 +265,9 @@ protected:
     uint m_triggerTime;
     uint m_elapsed;
 #endif
-    QDateTime m_startDate, m_endDate;
+    // Dates are kept as received until they are first asked for
+    mutable QDateTime m_startDate, m_endDate;
+    mutable QString m_startDateText, m_endDateText;
     QString m_uid;
     QString m_recurrenceId;
     QString m_notebookUid;
@@ -178,6 +277,29 @@ protected:
     unsigned m_cookie;
     unsigned m_timeoutSnoozeCounter;
     int m_maximalTimeoutSnoozeCount;
+
+    // Dirty fields not written yet, and those written but not confirmed
+    int m_dirty;
+    int m_savingDirty;
+    // The values timed last confirmed, and those of the write in flight
+    PersistedValues m_acknowledged;
+    PersistedValues m_writing;
+
+    // At most one write is in flight; saves requested meanwhile are coalesced into one
+    // follow-up write. Replies carrying an older generation have been superseded.
+    uint m_saveGeneration;
+    bool m_saveInFlight;
+    bool m_saveQueued;
+
+    quint64 m_sortKey;
+    // Computed when first read, until the alarm is edited or AlarmStore finds it has passed
+    mutable QDateTime m_nextOccurrence;
+    mutable bool m_nextOccurrenceValid;
+    // As reported by timed, set by AlarmStore
+    uint m_nextTriggerTime;
+    // Seconds left of a countdown, refreshed by CountdownTicker while it runs
+    int m_remaining;
+    bool m_ticking;
 };
 
 #endif
@@ -33,6 +33,8 @@
 #include "alarmsbackendmodel.h"
 #include "alarmsbackendmodel_p.h"
 #include "alarmobject.h"
+#include "alarmstore.h"
+#include <QDBusPendingCallWatcher>
 
 AlarmsBackendModel::AlarmsBackendModel(QObject *parent)
     : QAbstractListModel(parent), completed(false)
@@ -54,6 +56,10 @@ QHash<int, QByteArray> AlarmsBackendModel::roleNames() const
     roles[MinuteRole] = "minute";
     roles[SecondRole] = "second";
     roles[WeekDaysRole] = "daysOfWeek";
+    roles[DaysOfWeekMaskRole] = "daysOfWeekMask";
+    roles[NextOccurrenceRole] = "nextOccurrence";
+    roles[NextTriggerTimeRole] = "nextTriggerTime";
+    roles[RemainingRole] = "remaining";
     return roles;
 }
 
@@ -68,11 +74,99 @@ QHash<int, QByteArray> AlarmsBackendModel::roleNames() const
 AlarmObject *AlarmsBackendModel::createAlarm()
 {
     AlarmObject *alarm = new AlarmObject(this);
-    connect(alarm, SIGNAL(updated()), priv, SLOT(alarmUpdated()));
-    connect(alarm, SIGNAL(deleted()), priv, SLOT(alarmDeleted()));
+    priv->store->watch(alarm);
     return alarm;
 }
 
+/*!
+ *  \qmlmethod int AlarmsModel::rowForId(int id)
+ *
+ *  Returns the row of the alarm with the given \a id, or -1 if the model
+ *  does not contain such an alarm.
+ *
+ *  \sa Alarm::id
+ */
+int AlarmsBackendModel::rowForId(int id) const
+{
+    AlarmRecord *record = priv->store->recordById(id);
+    return record ? priv->rowOf(record) : -1;
+}
+
+/*!
+ *  \qmlmethod Alarm AlarmsModel::alarmById(int id)
+ *
+ *  Returns the alarm with the given \a id, or null if the model does not
+ *  contain such an alarm.
+ *
+ *  \sa Alarm::id
+ */
+AlarmObject *AlarmsBackendModel::alarmById(int id) const
+{
+    AlarmRecord *record = priv->store->recordById(id);
+    if (!record || priv->rowOf(record) < 0)
+        return 0;
+
+    return priv->store->object(record);
+}
+
+/*!
+ *  \qmlmethod void AlarmsModel::saveAll(list<Alarm> alarms)
+ *
+ *  Commit changes to several alarm objects to the backend at once. This has the same
+ *  effect as calling Alarm::save() on each of them, but takes a single request to
+ *  the backend. Each alarm emits Alarm::saved() when its new id is known, and
+ *  saveAllFinished() is emitted when the request has completed. Alarms that have
+ *  not been modified since they were last saved are skipped.
+ *
+ *  \sa Alarm::save()
+ */
+void AlarmsBackendModel::saveAll(const QVariantList &alarms)
+{
+    QList<AlarmObject*> objects;
+    foreach (const QVariant &value, alarms) {
+        AlarmObject *alarm = qobject_cast<AlarmObject*>(value.value<QObject*>());
+        if (alarm)
+            objects.append(alarm);
+    }
+
+    bool ok = false;
+    QDBusPendingCallWatcher *w = priv->store->saveAll(objects, &ok);
+    if (w)
+        connect(w, SIGNAL(finished(QDBusPendingCallWatcher*)), priv, SLOT(saveAllReply(QDBusPendingCallWatcher*)));
+    else
+        emit saveAllFinished(ok);
+}
+
+/*!
+ *  \qmlmethod void AlarmsModel::deleteAlarms(list<int> ids)
+ *
+ *  Remove the alarms with the given \a ids from the backend and the model with a
+ *  single request. Ids of alarms that are not in the model are ignored.
+ *
+ *  \sa Alarm::deleteAlarm()
+ */
+void AlarmsBackendModel::deleteAlarms(const QVariantList &ids)
+{
+    QList<AlarmRecord*> records;
+    QSet<AlarmRecord*> found;
+    foreach (const QVariant &id, ids) {
+        AlarmRecord *record = priv->store->recordById(id.toInt());
+        if (record && priv->rowOf(record) >= 0 && !found.contains(record)) {
+            found.insert(record);
+            records.append(record);
+        }
+    }
+
+    priv->store->deleteAlarms(records);
+}
+
+/*!
+ *  \qmlsignal AlarmsModel::saveAllFinished(bool success)
+ *
+ *  Emitted when the request made by saveAll() has completed. \a success is false
+ *  if the alarms could not be saved.
+ */
+
 /*!
  *  \qmlproperty bool AlarmsModel::populated
  *
@@ -86,19 +180,117 @@ bool AlarmsBackendModel::isPopulated() const
 
 bool AlarmsBackendModel::isOnlyCountdown() const
 {
-    return priv->countdown;
+    return priv->requestedCountdown;
 }
 
 void AlarmsBackendModel::setOnlyCountdown(bool countdown)
 {
-    if (priv->countdown == countdown)
+    if (priv->requestedCountdown == countdown)
         return;
 
-    priv->countdown = countdown;
+    priv->requestedCountdown = countdown;
     emit onlyCountdownChanged();
 
     if (completed)
-        priv->populate();
+        priv->schedulePopulate();
+}
+
+/*!
+ *  \qmlproperty int AlarmsModel::fetchBatchSize
+ *
+ *  Maximum number of alarms to load from the backend in one request. Rows are
+ *  added as each batch arrives, so that the first alarms can be shown before
+ *  a large set has been loaded completely. Each batch is requested as soon as
+ *  the previous one has been shown, views do not need to ask for them. 0, the
+ *  default, loads all alarms in a single request.
+ *
+ *  Alarms are loaded once for all models in the process, so the value is
+ *  shared by all models.
+ *
+ *  \sa populationProgress
+ */
+int AlarmsBackendModel::fetchBatchSize() const
+{
+    return priv->store->batchSize();
+}
+
+void AlarmsBackendModel::setFetchBatchSize(int size)
+{
+    size = qMax(0, size);
+    if (priv->store->batchSize() == size)
+        return;
+
+    priv->store->setBatchSize(size);
+    emit fetchBatchSizeChanged();
+}
+
+/*!
+ *  \qmlproperty real AlarmsModel::populationProgress
+ *
+ *  Fraction of the alarms in the backend that have been loaded into the model,
+ *  from 0 to 1.
+ *
+ *  \sa fetchBatchSize, populated
+ */
+qreal AlarmsBackendModel::populationProgress() const
+{
+    return priv->populationProgress;
+}
+
+/*!
+ *  \qmlproperty bool AlarmsModel::cacheEnabled
+ *
+ *  When true, the alarms loaded from the backend are kept in a cache file and
+ *  shown from there as soon as the next model is completed, before the backend
+ *  has replied. The cached rows are updated or removed once the backend has
+ *  been queried; populated only becomes true at that point. Defaults to false.
+ *
+ *  Like fetchBatchSize, the value is shared by all models in the process and
+ *  should be set before the model is completed.
+ */
+bool AlarmsBackendModel::isCacheEnabled() const
+{
+    return priv->store->isCacheEnabled();
+}
+
+void AlarmsBackendModel::setCacheEnabled(bool enabled)
+{
+    if (priv->store->isCacheEnabled() == enabled)
+        return;
+
+    priv->store->setCacheEnabled(enabled);
+    emit cacheEnabledChanged();
+}
+
+/*!
+ *  \qmlproperty bool AlarmsModel::backgroundDecoding
+ *
+ *  When true, the alarms received from the backend are decoded and sorted on
+ *  worker threads, spread over the available cores for large replies, so that
+ *  the user interface stays responsive while a large set is loaded. The rows of
+ *  each reply are then inserted at once. Defaults to false.
+ *
+ *  Like fetchBatchSize, the value is shared by all models in the process and
+ *  should be set before the model is completed.
+ */
+bool AlarmsBackendModel::isBackgroundDecoding() const
+{
+    return priv->store->isBackgroundDecoding();
+}
+
+void AlarmsBackendModel::setBackgroundDecoding(bool enabled)
+{
+    if (priv->store->isBackgroundDecoding() == enabled)
+        return;
+
+    priv->store->setBackgroundDecoding(enabled);
+    emit backgroundDecodingChanged();
+}
+
+// The record shown at \a row, for the filter models
+AlarmRecord *AlarmsBackendModel::record(int row) const
+{
+    return priv->alarms.value(row);
 }
 
 int AlarmsBackendModel::rowCount(const QModelIndex &parent) const
@@ -113,21 +305,38 @@ QVariant AlarmsBackendModel::data(const QModelIndex &index, int role) const
     if (!index.isValid() || index.row() < 0 || index.row() >= priv->alarms.size())
         return QVariant();
 
-    AlarmObject *alarm = priv->alarms[index.row()];
+    AlarmRecord *record = priv->alarms[index.row()];
 
     switch (role) {
-        case Qt::DisplayRole: return alarm->title();
-        case AlarmObjectRole: return QVariant::fromValue<QObject*>(alarm);
-        case EnabledRole: return alarm->isEnabled();
-        case HourRole: return alarm->hour();
-        case MinuteRole: return alarm->minute();
-        case SecondRole: return alarm->second();
-        case WeekDaysRole: return alarm->daysOfWeek();
+        case Qt::DisplayRole: return record->title;
+        case AlarmObjectRole: return QVariant::fromValue<QObject*>(priv->store->object(record));
+        case EnabledRole: return record->enabled;
+        case HourRole: return int(record->hour);
+        case MinuteRole: return int(record->minute);
+        case SecondRole: return int(record->second);
+        case WeekDaysRole: return AlarmObject::formatDaysOfWeek(record->daysOfWeek);
+        case DaysOfWeekMaskRole: return int(record->daysOfWeek);
+        case NextOccurrenceRole: {
+            qint64 next = record->nextOccurrence();
+            return next ? QDateTime::fromMSecsSinceEpoch(next) : QDateTime();
+        }
+        case NextTriggerTimeRole: return uint(record->nextTriggerTime);
+        case RemainingRole: return record->remaining();
     }
 
     return QVariant();
 }
 
+// Deletes the alarms in the rows from the backend, see deleteAlarms()
+bool AlarmsBackendModel::removeRows(int row, int count, const QModelIndex &parent)
+{
+    if (parent.isValid() || row < 0 || count <= 0 || row + count > priv->alarms.size())
+        return false;
+
+    priv->store->deleteAlarms(priv->alarms.mid(row, count));
+    return true;
+}
+
 void AlarmsBackendModel::classBegin()
 {
 }
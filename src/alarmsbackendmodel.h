@@ -38,12 +38,17 @@
 
 class AlarmsBackendModelPriv;
 class AlarmObject;
+struct AlarmRecord;
 
 class AlarmsBackendModel : public QAbstractListModel, public QQmlParserStatus
 {
     Q_OBJECT
     Q_PROPERTY(bool populated READ isPopulated NOTIFY populatedChanged)
     Q_PROPERTY(bool onlyCountdown READ isOnlyCountdown WRITE setOnlyCountdown NOTIFY onlyCountdownChanged)
+    Q_PROPERTY(int fetchBatchSize READ fetchBatchSize WRITE setFetchBatchSize NOTIFY fetchBatchSizeChanged)
+    Q_PROPERTY(qreal populationProgress READ populationProgress NOTIFY populationProgressChanged)
+    Q_PROPERTY(bool cacheEnabled READ isCacheEnabled WRITE setCacheEnabled NOTIFY cacheEnabledChanged)
+    Q_PROPERTY(bool backgroundDecoding READ isBackgroundDecoding WRITE setBackgroundDecoding NOTIFY backgroundDecodingChanged)
 
 public:
     enum {
@@ -52,20 +57,42 @@ public:
         HourRole,
         MinuteRole,
         SecondRole,
-        WeekDaysRole
+        WeekDaysRole,
+        DaysOfWeekMaskRole,
+        NextOccurrenceRole,
+        NextTriggerTimeRole,
+        RemainingRole
     };
 
     AlarmsBackendModel(QObject *parent = 0);
     virtual ~AlarmsBackendModel();
 
     Q_INVOKABLE AlarmObject *createAlarm();
+    Q_INVOKABLE int rowForId(int id) const;
+    Q_INVOKABLE AlarmObject *alarmById(int id) const;
+    Q_INVOKABLE void saveAll(const QVariantList &alarms);
+    Q_INVOKABLE void deleteAlarms(const QVariantList &ids);
     bool isPopulated() const;
 
+    AlarmRecord *record(int row) const;
+
     bool isOnlyCountdown() const;
     void setOnlyCountdown(bool countdown);
 
+    int fetchBatchSize() const;
+    void setFetchBatchSize(int size);
+
+    qreal populationProgress() const;
+
+    bool isCacheEnabled() const;
+    void setCacheEnabled(bool enabled);
+
+    bool isBackgroundDecoding() const;
+    void setBackgroundDecoding(bool enabled);
+
     virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
     QVariant data(const QModelIndex &index, int role) const;
+    bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex());
 
     void classBegin();
     void componentComplete();
@@ -75,6 +102,11 @@ public:
 signals:
     void populatedChanged();
     void onlyCountdownChanged();
+    void fetchBatchSizeChanged();
+    void populationProgressChanged();
+    void cacheEnabledChanged();
+    void backgroundDecodingChanged();
+    void saveAllFinished(bool success);
 
 protected:
     QHash<int, QByteArray> roleNames() const;
@@ -32,192 +32,465 @@
 
 #include "alarmsbackendmodel_p.h"
 #include "alarmobject.h"
-#include "interface.h"
-#include <QDBusMessage>
-#include <QDBusReply>
-#include <QQmlEngine>
+#include "countdownticker.h"
+#include <QDBusPendingCallWatcher>
+#include <QPair>
+#include <QSet>
+#include <QVector>
 #include <algorithm>
 
-inline static bool alarmSort(AlarmObject *a1, AlarmObject *a2)
-{
-    if (a1->hour() < a2->hour())
-        return true;
-    else if (a1->hour() > a2->hour())
-        return false;
-    else if (a1->minute() < a2->minute())
-        return true;
-    else if (a1->minute() > a2->minute())
-        return false;
-    
-    if (!a1->daysOfWeek().isEmpty() || !a2->daysOfWeek().isEmpty()) {
-        int re = a1->daysOfWeek().compare(a2->daysOfWeek());
-        if (re != 0)
-            return re < 0;
-    }
+inline static bool alarmSort(AlarmRecord *a1, AlarmRecord *a2)
+{
+    if (a1->sortKey != a2->sortKey)
+        return a1->sortKey < a2->sortKey;
+
+    return a1->title.compare(a2->title) < 0;
+}
+
+typedef QPair<quint64, AlarmRecord*> SortEntry;
+
+inline static bool sortEntryLessThan(const SortEntry &e1, const SortEntry &e2)
+{
+    if (e1.first != e2.first)
+        return e1.first < e2.first;
+
+    return e1.second->title.compare(e2.second->title) < 0;
+}
+
+// Stable sort on the packed keys, kept next to the pointers to avoid chasing them
+static void sortAlarms(QList<AlarmRecord*> &alarms)
+{
+    // Alarms decoded in the background arrive sorted already
+    if (std::is_sorted(alarms.constBegin(), alarms.constEnd(), alarmSort))
+        return;
 
-    int re = a1->title().compare(a2->title());
-    if (re == 0)
-        re = (a1->createdDate() < a2->createdDate()) ? -1 : 0;
+    QVector<SortEntry> entries;
+    entries.reserve(alarms.size());
+    foreach (AlarmRecord *alarm, alarms)
+        entries.append(qMakePair(alarm->sortKey, alarm));
 
-    return re < 0;
+    std::stable_sort(entries.begin(), entries.end(), sortEntryLessThan);
+
+    for (int i = 0; i < entries.size(); i++)
+        alarms[i] = entries[i].second;
 }
 
 AlarmsBackendModelPriv::AlarmsBackendModelPriv(AlarmsBackendModel *m)
-    : QObject(m), q(m), populated(false), countdown(false)
+    : QObject(m), q(m), store(AlarmStore::acquire()), active(false), populated(false),
+      countdown(false), requestedCountdown(false), populateGeneration(0), populationProgress(0),
+      ticking(false)
+{
+    connect(store, SIGNAL(alarmsInserted(QList<AlarmRecord*>)), SLOT(alarmsInserted(QList<AlarmRecord*>)));
+    connect(store, SIGNAL(alarmsRemoved(QList<AlarmRecord*>)), SLOT(alarmsRemoved(QList<AlarmRecord*>)));
+    connect(store, SIGNAL(alarmsChanged(QList<AlarmRecord*>)), SLOT(alarmsChanged(QList<AlarmRecord*>)));
+    connect(store, SIGNAL(alarmsReloaded(QList<AlarmRecord*>)), SLOT(alarmsReloaded(QList<AlarmRecord*>)));
+    connect(store, SIGNAL(populatedChanged(bool)), SLOT(populatedChanged(bool)));
+    connect(store, SIGNAL(populationProgressChanged(bool)), SLOT(populationProgressChanged(bool)));
+}
+
+AlarmsBackendModelPriv::~AlarmsBackendModelPriv()
 {
-    connect(TimedInterface::instance(), SIGNAL(alarmTriggersChanged(QMap<quint32,quint32>)),
-            this, SLOT(alarmTriggersChanged(QMap<quint32,quint32>)));
+    if (ticking)
+        CountdownTicker::instance()->release();
+    store->release();
 }
 
+// Show the alarms of the current type from the store, loading them from timed if
+// no other model has done so yet
 void AlarmsBackendModelPriv::populate()
 {
-    // Retrieve a list of cookies created by nemoalarms
-    QMap<QString,QVariant> attributes;
-    attributes.insert(QLatin1String("APPLICATION"), "nemoalarms");
-    if (countdown)
-        attributes.insert(QLatin1String("type"), "countdown");
-    else
-        attributes.insert(QLatin1String("type"), "clock");
+    populateGeneration++;
+    active = true;
+    countdown = requestedCountdown;
+    resetRows();
+
+    if (!store->isPopulated(countdown) && !store->isPopulating(countdown))
+        store->populate(countdown);
 
-    QDBusPendingCallWatcher *reply = new QDBusPendingCallWatcher(TimedInterface::instance()->query_async(attributes), this);
-    connect(reply, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(queryReply(QDBusPendingCallWatcher*)));
+    updatePopulated();
+    updateProgress();
+    prefetch();
 }
 
-void AlarmsBackendModelPriv::queryReply(QDBusPendingCallWatcher *call)
+// Load the other type of alarms in the background once the shown ones are in. The store
+// keeps both sets current, so switching onlyCountdown then only swaps the rows.
+void AlarmsBackendModelPriv::prefetch()
 {
-    QDBusPendingReply<QVariantList> reply = *call;
-    call->deleteLater();
+    if (active && store->isPopulated(countdown)
+            && !store->isPopulated(!countdown) && !store->isPopulating(!countdown))
+        store->populate(!countdown);
+}
 
-    if (reply.isError()) {
-        qWarning() << "Nemo.Alarms: Timed query failed:" << reply.error();
-        return;
+// Populate once control returns to the event loop. Only the latest request is carried
+// out, so changing the type repeatedly resets the model at most once.
+void AlarmsBackendModelPriv::schedulePopulate()
+{
+    QMetaObject::invokeMethod(this, "populateScheduled", Qt::QueuedConnection, Q_ARG(uint, ++populateGeneration));
+}
+
+void AlarmsBackendModelPriv::populateScheduled(uint generation)
+{
+    if (generation == populateGeneration && countdown != requestedCountdown)
+        populate();
+}
+
+bool AlarmsBackendModelPriv::accepts(AlarmRecord *alarm) const
+{
+    return active && alarm->countdown == countdown;
+}
+
+void AlarmsBackendModelPriv::resetRows()
+{
+    q->beginResetModel();
+
+    alarms.clear();
+    rows.clear();
+    foreach (AlarmRecord *alarm, store->records()) {
+        if (accepts(alarm))
+            alarms.append(alarm);
     }
+    sortAlarms(alarms);
+    reindex(0, alarms.size() - 1);
 
-    qDBusRegisterMetaType< QList<uint> >();
+    running.clear();
+    foreach (AlarmRecord *alarm, alarms)
+        updateRunning(alarm);
+    updateTicking();
 
-    QList<uint> cookies;
-    foreach (QVariant v, reply.value())
-        cookies.append(v.toUInt());
+    q->endResetModel();
+}
 
-    // Get a list of attributes for each of those cookies
-    QDBusPendingCall call2 = TimedInterface::instance()->get_attributes_by_cookies_async(cookies);
-    QDBusPendingCallWatcher *reply2 = new QDBusPendingCallWatcher(call2, this);
-    connect(reply2, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(attributesReply(QDBusPendingCallWatcher*)));
+// Follow the countdowns that are running in the model
+void AlarmsBackendModelPriv::updateRunning(AlarmRecord *alarm)
+{
+    if (rows.contains(alarm) && alarm->isRunning() && alarm->remaining() > 0)
+        running.insert(alarm);
+    else
+        running.remove(alarm);
 }
 
-void AlarmsBackendModelPriv::attributesReply(QDBusPendingCallWatcher *call)
+// Hold on to the shared ticker for as long as a countdown runs
+void AlarmsBackendModelPriv::updateTicking()
 {
-    // Q_FOREACH can't handle types containing commas
-    typedef QMap<QString,QString> attributes;
+    if (running.isEmpty() == !ticking)
+        return;
 
-    QDBusPendingReply<QMap<uint, attributes> > reply = *call;
-    call->deleteLater();
+    CountdownTicker *ticker = CountdownTicker::instance();
+    ticking = !running.isEmpty();
+    if (ticking) {
+        connect(ticker, SIGNAL(tick()), SLOT(tick()));
+        ticker->acquire();
+    } else {
+        disconnect(ticker, SIGNAL(tick()), this, SLOT(tick()));
+        ticker->release();
+    }
+}
 
-    if (reply.isError()) {
-        qWarning() << "Nemo.Alarms: Timed attributes query failed:" << reply.error();
-        return;
+void AlarmsBackendModelPriv::tick()
+{
+    QList<int> changedRows;
+    foreach (AlarmRecord *alarm, running)
+        changedRows.append(rowOf(alarm));
+    emitRowsChanged(changedRows, QVector<int>() << AlarmsBackendModel::RemainingRole);
+
+    // Countdowns that have run out stay at 0 until timed reports them
+    foreach (AlarmRecord *alarm, running.values())
+        updateRunning(alarm);
+    updateTicking();
+}
+
+void AlarmsBackendModelPriv::updatePopulated()
+{
+    if (!populated && active && store->isPopulated(countdown)) {
+        populated = true;
+        emit q->populatedChanged();
     }
+}
 
-    q->beginResetModel();
-    qDeleteAll(alarms);
-    alarms.clear();
+void AlarmsBackendModelPriv::updateProgress()
+{
+    qreal progress = store->populationProgress(countdown);
+    if (progress != populationProgress) {
+        populationProgress = progress;
+        emit q->populationProgressChanged();
+    }
+}
 
-    foreach (const attributes &data, reply.value()) {
-        AlarmObject *alarm = new AlarmObject(data, this);
-        connect(alarm, SIGNAL(updated()), SLOT(alarmUpdated()));
-        connect(alarm, SIGNAL(deleted()), SLOT(alarmDeleted()));
-        alarms.append(alarm);
+void AlarmsBackendModelPriv::saveAllReply(QDBusPendingCallWatcher *w)
+{
+    emit q->saveAllFinished(!w->isError());
+}
+
+void AlarmsBackendModelPriv::populatedChanged(bool countdownAlarms)
+{
+    if (countdownAlarms == countdown) {
+        updatePopulated();
+        prefetch();
     }
+}
 
-    std::sort(alarms.begin(), alarms.end(), alarmSort);
+void AlarmsBackendModelPriv::populationProgressChanged(bool countdownAlarms)
+{
+    if (countdownAlarms == countdown)
+        updateProgress();
+}
 
-    q->endResetModel();
+void AlarmsBackendModelPriv::alarmsInserted(const QList<AlarmRecord*> &added)
+{
+    QList<AlarmRecord*> newAlarms;
+    foreach (AlarmRecord *alarm, added) {
+        if (accepts(alarm) && !rows.contains(alarm))
+            newAlarms.append(alarm);
+    }
 
-    if (!populated) {
-        populated = true;
-        emit q->populatedChanged();
+    sortAlarms(newAlarms);
+
+    // Insert runs of new alarms that fall between the same two existing rows together
+    for (int i = 0; i < newAlarms.size(); ) {
+        QList<AlarmRecord*>::iterator pos = std::lower_bound(alarms.begin(), alarms.end(), newAlarms[i], alarmSort);
+        int row = pos - alarms.begin();
+
+        int last = i + 1;
+        while (last < newAlarms.size() && (row == alarms.size() || !alarmSort(alarms[row], newAlarms[last])))
+            last++;
+
+        q->beginInsertRows(QModelIndex(), row, row + last - i - 1);
+        for (int j = i; j < last; j++)
+            alarms.insert(row + j - i, newAlarms[j]);
+        reindex(row, alarms.size() - 1);
+        q->endInsertRows();
+
+        i = last;
     }
+
+    foreach (AlarmRecord *alarm, newAlarms)
+        updateRunning(alarm);
+    updateTicking();
 }
 
-void AlarmsBackendModelPriv::alarmTriggersChanged(QMap<quint32, quint32> triggerMap)
+void AlarmsBackendModelPriv::alarmsRemoved(const QList<AlarmRecord*> &removed)
 {
-    foreach (AlarmObject *alarm, alarms) {
-        if (!triggerMap.contains(alarm->id())) {
-            // Extra enabling logic is needed for not resetting alarms that were not active
-            if (alarm->isEnabled()) {
-                alarm->setEnabled(false);
-                alarm->reset();
-            }
-        } else if (!alarm->isCountdown()) {
-            alarm->setEnabled(true);
+    QList<int> removedRows;
+    foreach (AlarmRecord *alarm, removed) {
+        int row = rowOf(alarm);
+        if (row >= 0)
+            removedRows.append(row);
+    }
+
+    std::sort(removedRows.begin(), removedRows.end());
+
+    // Remove contiguous ranges, starting from the end so that the rows stay valid
+    for (int i = removedRows.size() - 1; i >= 0; ) {
+        int first = i;
+        while (first > 0 && removedRows[first - 1] == removedRows[first] - 1)
+            first--;
+
+        q->beginRemoveRows(QModelIndex(), removedRows[first], removedRows[i]);
+        for (int row = removedRows[i]; row >= removedRows[first]; row--) {
+            running.remove(alarms.at(row));
+            rows.remove(alarms.takeAt(row));
         }
+        reindex(removedRows[first], alarms.size() - 1);
+        q->endRemoveRows();
+
+        i = first - 1;
     }
+
+    updateTicking();
+}
+
+void AlarmsBackendModelPriv::alarmsChanged(const QList<AlarmRecord*> &changed)
+{
+    updateAlarms(changed, true);
 }
 
-void AlarmsBackendModelPriv::alarmUpdated()
+void AlarmsBackendModelPriv::alarmsReloaded(const QList<AlarmRecord*> &changed)
 {
-    AlarmObject *alarm = qobject_cast<AlarmObject*>(sender());
-    if (alarm)
-        alarmUpdated(alarm);
+    updateAlarms(changed, false);
 }
 
-void AlarmsBackendModelPriv::alarmUpdated(AlarmObject *alarm)
+// Bring the rows of modified alarms up to date. Alarms may also enter or leave the
+// model if their type changed. A single alarm is moved directly to its new row; for
+// several alarms either the minimal set of rows is moved or, with \a relayout, the
+// whole model is re-sorted with one layout change.
+void AlarmsBackendModelPriv::updateAlarms(const QList<AlarmRecord*> &changed, bool relayout)
 {
-    int currentRow = alarms.indexOf(alarm);
+    QList<AlarmRecord*> removed;
+    QList<AlarmRecord*> added;
+    QList<AlarmRecord*> updated;
+    foreach (AlarmRecord *alarm, changed) {
+        bool present = rows.contains(alarm);
+        if (accepts(alarm) && present)
+            updated.append(alarm);
+        else if (accepts(alarm))
+            added.append(alarm);
+        else if (present)
+            removed.append(alarm);
+    }
+
+    alarmsRemoved(removed);
+
+    if (updated.size() == 1)
+        repositionRow(rowOf(updated.first()));
+    else if (!updated.isEmpty() && relayout)
+        sortLayout();
+    else if (!updated.isEmpty())
+        sortRows();
+
+    QList<int> changedRows;
+    foreach (AlarmRecord *alarm, updated) {
+        changedRows.append(rowOf(alarm));
+        updateRunning(alarm);
+    }
+    emitRowsChanged(changedRows);
+    updateTicking();
+
+    alarmsInserted(added);
+}
+
+void AlarmsBackendModelPriv::repositionRow(int currentRow)
+{
+    AlarmRecord *alarm = alarms[currentRow];
 
     // std::lower_bound expects that the list is sorted, we do not know if that is the case after
     // the alarm has changed. Remove it temporarily from the list while calculating new row.
-    if (currentRow >= 0)
-        alarms.removeAt(currentRow);
-
-    QList<AlarmObject*>::iterator it = std::lower_bound(alarms.begin(), alarms.end(), alarm, alarmSort);
+    alarms.removeAt(currentRow);
+    QList<AlarmRecord*>::iterator it = std::lower_bound(alarms.begin(), alarms.end(), alarm, alarmSort);
     int newRow = it - alarms.begin();
+    alarms.insert(currentRow, alarm);
 
-    if (currentRow >= 0)
-        alarms.insert(currentRow, alarm);
+    if (newRow != currentRow)
+        moveRow(currentRow, newRow);
+}
 
-    if (currentRow < 0) {
-        alarm->setParent(this);
-        QQmlEngine::setObjectOwnership(alarm, QQmlEngine::CppOwnership);
+// Restore the sort order after alarms have been modified in place, moving as few rows
+// as possible: rows on the longest run that is already in order stay where they are.
+void AlarmsBackendModelPriv::sortRows()
+{
+    QList<AlarmRecord*> sorted = alarms;
+    sortAlarms(sorted);
+    if (sorted == alarms)
+        return;
 
-        q->beginInsertRows(QModelIndex(), newRow, newRow);
-        alarms.insert(newRow, alarm);
-        q->endInsertRows();
+    QHash<AlarmRecord*, int> target;
+    for (int i = 0; i < sorted.size(); i++)
+        target.insert(sorted[i], i);
+
+    // Longest increasing subsequence of target positions, in current row order
+    QVector<int> tails;
+    QVector<int> tailRows;
+    QVector<int> previous(alarms.size(), -1);
+    for (int row = 0; row < alarms.size(); row++) {
+        int pos = target.value(alarms[row]);
+        int n = std::lower_bound(tails.begin(), tails.end(), pos) - tails.begin();
+        if (n > 0)
+            previous[row] = tailRows[n - 1];
+        if (n == tails.size()) {
+            tails.append(pos);
+            tailRows.append(row);
+        } else {
+            tails[n] = pos;
+            tailRows[n] = row;
+        }
+    }
+
+    QSet<AlarmRecord*> inPlace;
+    for (int row = tailRows.isEmpty() ? -1 : tailRows.last(); row >= 0; row = previous[row])
+        inPlace.insert(alarms[row]);
+
+    // Place every other alarm directly after its predecessor in the sorted order
+    for (int i = 0; i < sorted.size(); i++) {
+        if (inPlace.contains(sorted[i]))
+            continue;
+
+        int from = rowOf(sorted[i]);
+        int to = (i == 0) ? 0 : rowOf(sorted[i - 1]) + 1;
+        if (to == from)
+            continue;
+
+        moveRow(from, to > from ? to - 1 : to);
+    }
+}
+
+// Restore the sort order with a single layout change, for when many alarms may have
+// moved at once
+void AlarmsBackendModelPriv::sortLayout()
+{
+    QList<AlarmRecord*> sorted = alarms;
+    sortAlarms(sorted);
+    if (sorted == alarms)
         return;
-    } else if (newRow != currentRow) {
-        q->beginMoveRows(QModelIndex(), currentRow, currentRow, QModelIndex(), newRow > currentRow ? newRow + 1 : newRow);
-        alarms.move(currentRow, newRow);
-        q->endMoveRows();
-    } else
-        emit q->dataChanged(q->index(currentRow, 0), q->index(currentRow, 0));
+
+    emit q->layoutAboutToBeChanged();
+
+    QList<AlarmRecord*> previous = alarms;
+    alarms = sorted;
+    reindex(0, alarms.size() - 1);
+
+    QModelIndexList from = q->persistentIndexList();
+    QModelIndexList to;
+    foreach (const QModelIndex &persistent, from)
+        to.append(q->index(rowOf(previous[persistent.row()]), 0));
+    q->changePersistentIndexList(from, to);
+
+    emit q->layoutChanged();
 }
 
-void AlarmsBackendModelPriv::alarmDeleted()
+// Move a single row so that it ends up at index \a to
+void AlarmsBackendModelPriv::moveRow(int from, int to)
 {
-    AlarmObject *alarm = qobject_cast<AlarmObject*>(sender());
-    if (alarm)
-        alarmDeleted(alarm);
+    q->beginMoveRows(QModelIndex(), from, from, QModelIndex(), to > from ? to + 1 : to);
+    alarms.move(from, to);
+    reindex(qMin(from, to), qMax(from, to));
+    q->endMoveRows();
 }
 
-void AlarmsBackendModelPriv::alarmDeleted(AlarmObject *alarm)
+// Refresh the row numbers of the alarms at rows first..last after a structural change
+void AlarmsBackendModelPriv::reindex(int first, int last)
 {
-    int row = alarms.indexOf(alarm);
-    if (row >= 0) {
-        q->beginRemoveRows(QModelIndex(), row, row);
-        alarms.removeAt(row);
-        q->endRemoveRows();
-    }
+    for (int row = first; row <= last; row++)
+        rows[alarms[row]] = row;
+}
 
-    alarm->deleteLater();
+int AlarmsBackendModelPriv::rowOf(AlarmRecord *alarm) const
+{
+    return rows.value(alarm, -1);
+}
+
+void AlarmsBackendModelPriv::emitRowsChanged(QList<int> changedRows, const QVector<int> &roles)
+{
+    std::sort(changedRows.begin(), changedRows.end());
+
+    for (int i = 0; i < changedRows.size(); ) {
+        int last = i;
+        while (last + 1 < changedRows.size() && changedRows[last + 1] <= changedRows[last] + 1)
+            last++;
+        emit q->dataChanged(q->index(changedRows[i], 0), q->index(changedRows[last], 0), roles);
+        i = last + 1;
+    }
 }
 
 void AlarmsBackendModelPriv::reset()
 {
-    foreach (AlarmObject *alarm, alarms) {
+    // The models hear of all of them at once
+    store->beginBatchUpdate();
+
+    QList<AlarmObject*> countdowns;
+    foreach (AlarmRecord *record, alarms) {
+        if (!record->countdown)
+            continue;
+
+        AlarmObject *alarm = store->object(record);
         if (alarm->type() == AlarmObject::Countdown) {
             alarm->setEnabled(false);
             alarm->reset();
-            alarm->save();
+            countdowns.append(alarm);
         }
     }
+
+    // All of them are saved with one request
+    if (!countdowns.isEmpty())
+        store->saveAll(countdowns);
+
+    store->endBatchUpdate();
 }
@@ -33,9 +33,9 @@
 #ifndef ALARMSBACKENDMODEL_P_H
 #define ALARMSBACKENDMODEL_P_H
 #include "alarmsbackendmodel.h"
-
-class AlarmObject;
-class QDBusPendingCallWatcher;
+#include "alarmstore.h"
+#include <QSet>
+#include <QVector>
 
 class AlarmsBackendModelPriv : public QObject
 {
@@ -43,25 +43,56 @@ class AlarmsBackendModelPriv : public QObject
 
 public:
     AlarmsBackendModel *q;
-    QList<AlarmObject*> alarms;
+    AlarmStore *store;
+    QList<AlarmRecord*> alarms;
+    // Row of every alarm in the model, kept in sync with alarms
+    QHash<AlarmRecord*, int> rows;
+    bool active;
     bool populated;
+    // Type of the alarms shown, and the type set through onlyCountdown. They differ
+    // until the scheduled population runs.
     bool countdown;
+    bool requestedCountdown;
+    uint populateGeneration;
+    qreal populationProgress;
+    // Rows of running countdowns, refreshed on every tick of CountdownTicker
+    QSet<AlarmRecord*> running;
+    bool ticking;
 
     AlarmsBackendModelPriv(AlarmsBackendModel *q);
+    ~AlarmsBackendModelPriv();
     void populate();
+    void schedulePopulate();
+    void prefetch();
     void reset();
 
+    bool accepts(AlarmRecord *alarm) const;
+    void resetRows();
+    void updateAlarms(const QList<AlarmRecord*> &changed, bool relayout);
+    void repositionRow(int currentRow);
+    void sortRows();
+    void sortLayout();
+    void emitRowsChanged(QList<int> changedRows, const QVector<int> &roles = QVector<int>());
+    void updateRunning(AlarmRecord *alarm);
+    void updateTicking();
+    void moveRow(int from, int to);
+    void reindex(int first, int last);
+    int rowOf(AlarmRecord *alarm) const;
+    void updatePopulated();
+    void updateProgress();
+
 public slots:
-    void alarmUpdated();
-    void alarmUpdated(AlarmObject *alarm);
-    void alarmDeleted();
-    void alarmDeleted(AlarmObject *alarm);
+    void alarmsInserted(const QList<AlarmRecord*> &added);
+    void alarmsRemoved(const QList<AlarmRecord*> &removed);
+    void alarmsChanged(const QList<AlarmRecord*> &changed);
+    void alarmsReloaded(const QList<AlarmRecord*> &changed);
 
 private slots:
-    void queryReply(QDBusPendingCallWatcher *w);
-    void attributesReply(QDBusPendingCallWatcher *w);
-    void alarmTriggersChanged(QMap<quint32, quint32> triggerMap);
+    void populateScheduled(uint generation);
+    void saveAllReply(QDBusPendingCallWatcher *w);
+    void populatedChanged(bool countdownAlarms);
+    void populationProgressChanged(bool countdownAlarms);
+    void tick();
 };
 
 #endif
-
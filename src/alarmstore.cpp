@@ -0,0 +1,1394 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "alarmstore.h"
+#include "alarmobject.h"
+#include "alarmattributes.h"
+#include "interface.h"
+#include <QDBusMetaType>
+#include <QDBusPendingReply>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QQmlEngine>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+#include <QtConcurrentMap>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <timed-qt6/event>
+#include <timed-qt6/exception>
+#else
+#include <timed-qt5/event>
+#include <timed-qt5/exception>
+#endif
+
+static const quint32 CacheMagic = 0x6e616c63; // "nalc"
+static const quint32 CacheVersion = 3;
+// The cache is written once the alarms have not changed for this long
+static const int CacheSaveDelay = 1000;
+
+AlarmRecord::AlarmRecord()
+    : sortKey(0), cookie(0), hour(0), minute(0), second(0), daysOfWeek(0), type(AlarmObject::Clock), enabled(false),
+      countdown(false), triggerTime(0), elapsed(0), timeoutSnoozeCounter(0), maximalTimeoutSnoozeCount(0),
+      partial(false), nextOccurrenceCache(0), nextOccurrenceValid(false),
+      nextTriggerTime(0)
+{
+}
+
+static bool assignProperties(AlarmRecord *record, const AlarmRecord &other)
+{
+    bool changed = record->title != other.title || record->daysOfWeek != other.daysOfWeek
+            || record->sortKey != other.sortKey || record->hour != other.hour
+            || record->minute != other.minute || record->second != other.second
+            || record->enabled != other.enabled || record->countdown != other.countdown
+            || record->type != other.type || record->notebookUid != other.notebookUid
+            || record->triggerTime != other.triggerTime || record->elapsed != other.elapsed
+            || record->timeoutSnoozeCounter != other.timeoutSnoozeCounter
+            || record->maximalTimeoutSnoozeCount != other.maximalTimeoutSnoozeCount;
+
+    record->title = other.title;
+    record->notebookUid = other.notebookUid;
+    record->daysOfWeek = other.daysOfWeek;
+    record->sortKey = other.sortKey;
+    record->hour = other.hour;
+    record->minute = other.minute;
+    record->second = other.second;
+    record->type = other.type;
+    record->enabled = other.enabled;
+    record->countdown = other.countdown;
+    record->triggerTime = other.triggerTime;
+    record->elapsed = other.elapsed;
+    record->timeoutSnoozeCounter = other.timeoutSnoozeCounter;
+    record->maximalTimeoutSnoozeCount = other.maximalTimeoutSnoozeCount;
+    record->partial = other.partial;
+    if (changed)
+        record->invalidateNextOccurrence();
+    return changed;
+}
+
+// Decode the properties kept in the record from timed attributes the way
+// AlarmObject::loadAttributes() does. Returns true if any of them changed.
+bool AlarmRecord::load(const QMap<QString,QString> &data)
+{
+    AlarmRecord decoded;
+    // Keep the creation time if it is not given, like AlarmObject::reload()
+    qint64 created = sortKey ? qint64(sortKey & ((Q_UINT64_C(1) << 43) - 1)) : QDateTime::currentMSecsSinceEpoch();
+    bool reminder = false;
+    bool startDate = false;
+    bool endDate = false;
+
+    for (QMap<QString,QString>::ConstIterator it = data.begin(); it != data.end(); it++) {
+        switch (AlarmAttributes::key(it.key())) {
+        case AlarmAttributes::Title:
+            decoded.title = it.value();
+            break;
+        case AlarmAttributes::Cookie:
+            cookie = AlarmAttributes::toInteger(it.value());
+            break;
+        case AlarmAttributes::DaysOfWeek: {
+            int mask = AlarmObject::parseDaysOfWeek(it.value());
+            if (mask >= 0)
+                decoded.daysOfWeek = mask;
+            break;
+        }
+        case AlarmAttributes::CreatedDate:
+            created = AlarmAttributes::toCreatedMSecs(it.value());
+            break;
+        case AlarmAttributes::Elapsed:
+            decoded.elapsed = AlarmAttributes::toInteger(it.value());
+            break;
+        case AlarmAttributes::TimeOfDayWithSeconds: {
+            int value = AlarmAttributes::toInteger(it.value());
+            decoded.hour = value / 3600;
+            decoded.minute = (value % 3600) / 60;
+            decoded.second = value % 60;
+            break;
+        }
+        case AlarmAttributes::TimeOfDay: {
+            int value = AlarmAttributes::toInteger(it.value());
+            decoded.hour = value / 60;
+            decoded.minute = value % 60;
+            break;
+        }
+        case AlarmAttributes::State:
+            decoded.enabled = it.value() != QLatin1String("TRANQUIL") && it.value() != QLatin1String("WAITING");
+            break;
+        case AlarmAttributes::TriggerTime:
+            decoded.countdown = true;
+            decoded.triggerTime = AlarmAttributes::toInteger(it.value());
+            break;
+        case AlarmAttributes::StartDate:
+            startDate = !it.value().isEmpty();
+            decoded.partial = true;
+            break;
+        case AlarmAttributes::EndDate:
+            endDate = !it.value().isEmpty();
+            decoded.partial = true;
+            break;
+        case AlarmAttributes::Uid:
+        case AlarmAttributes::RecurrenceId:
+        case AlarmAttributes::PhoneNumber:
+            decoded.partial = true;
+            break;
+        case AlarmAttributes::TimeoutSnoozeCounter:
+            decoded.timeoutSnoozeCounter = AlarmAttributes::toInteger(it.value());
+            break;
+        case AlarmAttributes::MaximalTimeoutSnoozeCounter:
+            decoded.maximalTimeoutSnoozeCount = AlarmAttributes::toInteger(it.value());
+            break;
+        case AlarmAttributes::Notebook:
+            decoded.notebookUid = it.value();
+            break;
+        case AlarmAttributes::Type:
+            reminder = it.value() == QLatin1String("reminder");
+            break;
+        default:
+            break;
+        }
+    }
+
+    // As AlarmObject::type()
+    if (reminder)
+        decoded.type = AlarmObject::Reminder;
+    else if (startDate && endDate)
+        decoded.type = AlarmObject::Calendar;
+    else
+        decoded.type = decoded.countdown ? AlarmObject::Countdown : AlarmObject::Clock;
+
+    decoded.sortKey = AlarmObject::makeSortKey(decoded.hour, decoded.minute, decoded.daysOfWeek, created);
+    return assignProperties(this, decoded);
+}
+
+// Take the properties from a modified object. The cookie is tracked separately by the
+// store.
+bool AlarmRecord::load(const AlarmObject *alarm)
+{
+    AlarmRecord current;
+    current.title = alarm->title();
+    current.notebookUid = alarm->notebookUid();
+    current.daysOfWeek = alarm->daysOfWeekMask();
+    current.sortKey = alarm->sortKey();
+    current.hour = alarm->hour();
+    current.minute = alarm->minute();
+    current.second = alarm->second();
+    current.type = alarm->type();
+    current.enabled = alarm->isEnabled();
+    current.countdown = alarm->isCountdown();
+    current.triggerTime = alarm->triggerTime();
+    current.elapsed = alarm->getElapsed();
+    current.timeoutSnoozeCounter = alarm->timeoutSnoozeCounter();
+    current.maximalTimeoutSnoozeCount = alarm->maximalTimeoutSnoozeCount();
+    current.partial = partial;
+    return assignProperties(this, current);
+}
+
+// Attributes to create an AlarmObject from. They give the same properties as the record;
+// the full attributes of partial records arrive from timed later.
+QMap<QString,QString> AlarmRecord::attributes() const
+{
+    QMap<QString,QString> data;
+    data.insert(QLatin1String("COOKIE"), QString::number(cookie));
+    data.insert(QLatin1String("TITLE"), title);
+    data.insert(QLatin1String("STATE"), enabled ? QLatin1String("ARMED") : QLatin1String("WAITING"));
+    data.insert(QLatin1String("createdDate"), QString::number(sortKey & ((Q_UINT64_C(1) << 43) - 1)));
+    data.insert(QLatin1String("timeOfDayWithSeconds"), QString::number(hour * 3600 + minute * 60 + second));
+    if (daysOfWeek)
+        data.insert(QLatin1String("daysOfWeek"), AlarmObject::formatDaysOfWeek(daysOfWeek));
+    if (countdown) {
+        data.insert(QLatin1String("triggerTime"), QString::number(triggerTime));
+        data.insert(QLatin1String("elapsed"), QString::number(elapsed));
+    }
+    if (timeoutSnoozeCounter)
+        data.insert(QLatin1String("timeoutSnoozeCounter"), QString::number(timeoutSnoozeCounter));
+    if (maximalTimeoutSnoozeCount)
+        data.insert(QLatin1String("maximalTimeoutSnoozeCounter"), QString::number(maximalTimeoutSnoozeCount));
+    if (type == AlarmObject::Reminder)
+        data.insert(QLatin1String("type"), QLatin1String("reminder"));
+    if (!notebookUid.isEmpty())
+        data.insert(QLatin1String("notebook"), notebookUid);
+    return data;
+}
+
+// Apply a state change from a trigger map to a record without an object, so that an
+// object created later starts from the same state
+void AlarmRecord::setEnabled(bool e)
+{
+    enabled = e;
+
+    // As in AlarmObject::reset()
+    if (!e && countdown) {
+        triggerTime = 0;
+        elapsed = 0;
+    }
+    invalidateNextOccurrence();
+}
+
+// As AlarmObject::remaining, computed for the current time rather than the last tick.
+// Modified objects know better than the record.
+int AlarmRecord::remaining() const
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (object)
+        return object->remainingAt(now);
+    if (!countdown)
+        return 0;
+
+    return AlarmObject::calculateRemaining(hour * 3600 + minute * 60 + second,
+                                           isRunning() ? qint64(triggerTime) * 1000 : 0, elapsed, now);
+}
+
+// The next occurrence from the decoded properties, like AlarmObject::nextOccurrence();
+// 0 if there is none
+qint64 AlarmRecord::nextOccurrence() const
+{
+    if (countdown)
+        return isRunning() ? qint64(triggerTime) * 1000 : 0;
+
+    if (!nextOccurrenceValid) {
+        QDateTime next = AlarmObject::calculateNextOccurrence(hour, minute, second, daysOfWeek,
+                                                              QDateTime::currentDateTime());
+        nextOccurrenceCache = next.isValid() ? next.toMSecsSinceEpoch() : 0;
+        nextOccurrenceValid = true;
+        if (nextOccurrenceCache)
+            AlarmStore::occurrenceComputed(nextOccurrenceCache);
+    }
+    return nextOccurrenceCache;
+}
+
+AlarmStore *AlarmStore::s_instance = 0;
+
+AlarmStore::AlarmSet::AlarmSet()
+    : populated(false), querying(false), generation(0), fetchingCount(0), fetchedCount(0), totalCount(0),
+      decodingCount(0)
+{
+}
+
+AlarmStore::AlarmStore()
+    : m_refCount(0), m_batchSize(0), m_cacheEnabled(false), m_backgroundDecoding(false), m_batchUpdating(0),
+      m_occurrenceTimer(new QTimer(this)), m_occurrenceDeadline(0), m_cacheTimer(new QTimer(this))
+{
+    m_occurrenceTimer->setSingleShot(true);
+    connect(m_occurrenceTimer, SIGNAL(timeout()), SLOT(updateOccurrences()));
+    connect(TimedInterface::instance(), SIGNAL(systemTimeChanged()), SLOT(resetOccurrences()));
+
+    // Every change to the alarms, including a population that found none, is written
+    // to the cache
+    m_cacheTimer->setSingleShot(true);
+    m_cacheTimer->setInterval(CacheSaveDelay);
+    connect(m_cacheTimer, SIGNAL(timeout()), SLOT(saveCaches()));
+    connect(this, SIGNAL(alarmsInserted(QList<AlarmRecord*>)), SLOT(scheduleCacheSave()));
+    connect(this, SIGNAL(alarmsRemoved(QList<AlarmRecord*>)), SLOT(scheduleCacheSave()));
+    connect(this, SIGNAL(alarmsChanged(QList<AlarmRecord*>)), SLOT(scheduleCacheSave()));
+    connect(this, SIGNAL(alarmsReloaded(QList<AlarmRecord*>)), SLOT(scheduleCacheSave()));
+    connect(this, SIGNAL(populatedChanged(bool)), SLOT(scheduleCacheSave()));
+
+    connect(TimedInterface::instance(), SIGNAL(alarmTriggerDelta(TriggerDelta)),
+            this, SLOT(alarmTriggerDelta(TriggerDelta)));
+}
+
+AlarmStore::~AlarmStore()
+{
+    // Changes made after release()
+    if (m_cacheTimer->isActive())
+        saveCaches();
+
+    // Decoding runs on the thread pool, its records have to be waited for
+    foreach (QFutureWatcher<QList<AlarmRecord*> > *watcher, m_decoding.keys()) {
+        watcher->waitForFinished();
+        qDeleteAll(watcher->result());
+    }
+
+    // Objects that were only read have no parent
+    foreach (AlarmRecord *record, m_records) {
+        if (record->object && !record->object->parent())
+            delete record->object.data();
+    }
+    qDeleteAll(m_records);
+}
+
+// Returns the shared store, creating it if needed. Every call must be balanced
+// with a call to release().
+AlarmStore *AlarmStore::acquire()
+{
+    if (!s_instance)
+        s_instance = new AlarmStore;
+    s_instance->m_refCount++;
+    return s_instance;
+}
+
+void AlarmStore::release()
+{
+    if (--m_refCount > 0)
+        return;
+
+    if (s_instance == this)
+        s_instance = 0;
+
+    // Written now rather than on deletion, so that a store acquired meanwhile reads the
+    // current alarms, and nothing is lost if the event loop does not run again
+    if (m_cacheTimer->isActive()) {
+        m_cacheTimer->stop();
+        saveCaches();
+    }
+    deleteLater();
+}
+
+AlarmRecord *AlarmStore::recordById(int id) const
+{
+    return id ? m_ids.value(id) : 0;
+}
+
+// Returns the object for a record, creating it when it is first asked for. An object
+// that is only read belongs to the QML engine and may be collected once nothing refers
+// to it; it is created again on the next call. Once modified it stays with the record.
+// The object starts from the properties of the record, which are all that saving it needs.
+// Partial records also fetch the rest of their attributes from timed, which are applied
+// unless the object has been modified by then.
+AlarmObject *AlarmStore::object(AlarmRecord *record)
+{
+    if (!record->object) {
+        AlarmObject *alarm = new AlarmObject(record->attributes());
+        QQmlEngine::setObjectOwnership(alarm, QQmlEngine::JavaScriptOwnership);
+        attach(record, alarm);
+
+        if (record->cookie && record->partial) {
+            if (m_objectCookies.isEmpty())
+                QMetaObject::invokeMethod(this, "fetchObjectAttributes", Qt::QueuedConnection);
+            m_objectCookies.append(record->cookie);
+        }
+    }
+    return record->object;
+}
+
+void AlarmStore::fetchObjectAttributes()
+{
+    QList<uint> cookies = m_objectCookies;
+    m_objectCookies.clear();
+    sync(cookies);
+}
+
+// Track an alarm that is not in the store yet, such as one returned by
+// AlarmsModel::createAlarm(). It is added when it is first saved.
+void AlarmStore::watch(AlarmObject *alarm)
+{
+    connect(alarm, SIGNAL(updated()), SLOT(alarmUpdated()), Qt::UniqueConnection);
+    connect(alarm, SIGNAL(deleted()), SLOT(alarmDeleted()), Qt::UniqueConnection);
+    connect(alarm, SIGNAL(idChanged()), SLOT(alarmIdChanged()), Qt::UniqueConnection);
+}
+
+bool AlarmStore::isPopulated(bool countdown) const
+{
+    return alarmSet(countdown).populated;
+}
+
+bool AlarmStore::isPopulating(bool countdown) const
+{
+    const AlarmSet &set = alarmSet(countdown);
+    return set.querying || set.fetchingCount > 0 || set.decodingCount > 0 || !set.pendingCookies.isEmpty();
+}
+
+qreal AlarmStore::populationProgress(bool countdown) const
+{
+    const AlarmSet &set = alarmSet(countdown);
+    if (set.totalCount > 0)
+        return qreal(set.fetchedCount) / set.totalCount;
+    return set.populated ? 1.0 : 0.0;
+}
+
+void AlarmStore::setBatchSize(int size)
+{
+    m_batchSize = qMax(0, size);
+}
+
+void AlarmStore::setCacheEnabled(bool enabled)
+{
+    m_cacheEnabled = enabled;
+    scheduleCacheSave();
+}
+
+void AlarmStore::setBackgroundDecoding(bool enabled)
+{
+    m_backgroundDecoding = enabled;
+}
+
+// Load the alarms of one type from timed. A population that is still in progress is
+// superseded and its outstanding replies are discarded.
+void AlarmStore::populate(bool countdown)
+{
+    // Show the alarms from the last population right away; they are reconciled with
+    // timed when the replies below arrive
+    if (m_cacheEnabled && !alarmSet(countdown).populated)
+        loadCache(countdown);
+
+    // Retrieve a list of cookies created by nemoalarms
+    QMap<QString,QVariant> attributes;
+    attributes.insert(QLatin1String("APPLICATION"), "nemoalarms");
+    if (countdown)
+        attributes.insert(QLatin1String("type"), "countdown");
+    else
+        attributes.insert(QLatin1String("type"), "clock");
+
+    AlarmSet &set = alarmSet(countdown);
+    set.generation++;
+    set.querying = true;
+    set.pendingCookies.clear();
+    set.fetchingCount = 0;
+    set.decodingCount = 0;
+
+    QDBusPendingCallWatcher *reply = new QDBusPendingCallWatcher(TimedInterface::instance()->query_async(attributes), this);
+    reply->setProperty("countdown", countdown);
+    reply->setProperty("generation", set.generation);
+    connect(reply, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(queryReply(QDBusPendingCallWatcher*)));
+}
+
+void AlarmStore::queryReply(QDBusPendingCallWatcher *call)
+{
+    QDBusPendingReply<QVariantList> reply = *call;
+    call->deleteLater();
+
+    bool countdown = call->property("countdown").toBool();
+    AlarmSet &set = alarmSet(countdown);
+    if (call->property("generation").toUInt() != set.generation)
+        return;
+    set.querying = false;
+
+    if (reply.isError()) {
+        qWarning() << "Nemo.Alarms: Timed query failed:" << reply.error();
+        return;
+    }
+
+    qDBusRegisterMetaType< QList<uint> >();
+
+    QList<uint> cookies;
+    QSet<uint> existing;
+    foreach (QVariant v, reply.value()) {
+        cookies.append(v.toUInt());
+        existing.insert(v.toUInt());
+    }
+
+    // Alarms that are gone can be dropped right away, the others are updated in place
+    // as their attributes arrive
+    removeMissing(countdown, existing);
+
+    set.pendingCookies = cookies;
+    set.fetchedCount = 0;
+    set.totalCount = cookies.size();
+    emit populationProgressChanged(countdown);
+
+    if (cookies.isEmpty() && !set.populated) {
+        set.populated = true;
+        emit populatedChanged(countdown);
+        emit populationProgressChanged(countdown);
+    } else {
+        fetchMore(countdown);
+    }
+}
+
+// Request attributes for the next batch of cookies, or for all of them if no batch
+// size is set
+void AlarmStore::fetchMore(bool countdown)
+{
+    AlarmSet &set = alarmSet(countdown);
+    if (set.fetchingCount > 0 || set.pendingCookies.isEmpty())
+        return;
+
+    QList<uint> cookies;
+    if (m_batchSize > 0 && set.pendingCookies.size() > m_batchSize) {
+        cookies = set.pendingCookies.mid(0, m_batchSize);
+        set.pendingCookies = set.pendingCookies.mid(m_batchSize);
+    } else {
+        cookies = set.pendingCookies;
+        set.pendingCookies.clear();
+    }
+    set.fetchingCount = cookies.size();
+
+    // Get a list of attributes for each of those cookies
+    QDBusPendingCall call = TimedInterface::instance()->get_attributes_by_cookies_async(cookies);
+    QDBusPendingCallWatcher *reply = new QDBusPendingCallWatcher(call, this);
+    reply->setProperty("countdown", countdown);
+    reply->setProperty("generation", set.generation);
+    connect(reply, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(attributesReply(QDBusPendingCallWatcher*)));
+}
+
+void AlarmStore::attributesReply(QDBusPendingCallWatcher *call)
+{
+    QDBusPendingReply<QMap<uint, QMap<QString,QString> > > reply = *call;
+    call->deleteLater();
+
+    bool countdown = call->property("countdown").toBool();
+    AlarmSet &set = alarmSet(countdown);
+    if (call->property("generation").toUInt() != set.generation)
+        return;
+    set.fetchedCount += set.fetchingCount;
+    set.fetchingCount = 0;
+
+    if (reply.isError()) {
+        qWarning() << "Nemo.Alarms: Timed attributes query failed:" << reply.error();
+        set.pendingCookies.clear();
+        return;
+    }
+
+    if (m_backgroundDecoding) {
+        decode(countdown, reply.value());
+        return;
+    }
+
+    merge(reply.value());
+    attributesLoaded(countdown);
+}
+
+// Continue the population once a batch of alarms has been shown
+void AlarmStore::attributesLoaded(bool countdown)
+{
+    AlarmSet &set = alarmSet(countdown);
+    emit populationProgressChanged(countdown);
+
+    if (!set.pendingCookies.isEmpty()) {
+        fetchMore(countdown);
+        return;
+    }
+    if (set.fetchingCount > 0 || set.decodingCount > 0)
+        return;
+
+    if (!set.populated) {
+        set.populated = true;
+        emit populatedChanged(countdown);
+    }
+}
+
+static bool recordLessThan(const AlarmRecord *r1, const AlarmRecord *r2)
+{
+    if (r1->sortKey != r2->sortKey)
+        return r1->sortKey < r2->sortKey;
+
+    return r1->title.compare(r2->title) < 0;
+}
+
+// Runs on the thread pool: decode part of a reply into records sorted like the models
+static QList<AlarmRecord*> decodeRecords(const QMap<uint, QMap<QString,QString> > &attributes)
+{
+    QList<AlarmRecord*> records;
+    records.reserve(attributes.size());
+    for (QMap<uint, QMap<QString,QString> >::const_iterator it = attributes.constBegin(); it != attributes.constEnd(); ++it) {
+        AlarmRecord *record = new AlarmRecord;
+        record->load(it.value());
+        records.append(record);
+    }
+
+    std::stable_sort(records.begin(), records.end(), recordLessThan);
+    return records;
+}
+
+// Runs on the thread pool, one part at a time: merge the sorted parts into one list
+static void mergeRecords(QList<AlarmRecord*> &result, const QList<AlarmRecord*> &records)
+{
+    QList<AlarmRecord*> merged;
+    merged.reserve(result.size() + records.size());
+    std::merge(result.constBegin(), result.constEnd(), records.constBegin(), records.constEnd(),
+               std::back_inserter(merged), recordLessThan);
+    result = merged;
+}
+
+// Replies with fewer alarms are decoded in one piece
+static const int DecodePartSize = 64;
+
+// Decode the attributes into sorted records on the thread pool, splitting large replies
+// over the available cores. The records are merged into the store by decodeFinished().
+void AlarmStore::decode(bool countdown, const QMap<uint, QMap<QString,QString> > &records)
+{
+    int parts = qBound(1, records.size() / DecodePartSize, qMax(1, QThread::idealThreadCount()));
+    int partSize = (records.size() + parts - 1) / parts;
+
+    QList<QMap<uint, QMap<QString,QString> > > split;
+    for (QMap<uint, QMap<QString,QString> >::const_iterator it = records.constBegin(); it != records.constEnd(); ++it) {
+        if (split.isEmpty() || split.last().size() >= partSize)
+            split.append(QMap<uint, QMap<QString,QString> >());
+        split.last().insert(it.key(), it.value());
+    }
+
+    AlarmSet &set = alarmSet(countdown);
+    set.decodingCount++;
+
+    QFutureWatcher<QList<AlarmRecord*> > *watcher = new QFutureWatcher<QList<AlarmRecord*> >(this);
+    watcher->setProperty("countdown", countdown);
+    watcher->setProperty("generation", set.generation);
+    m_decoding.insert(watcher, records);
+    connect(watcher, SIGNAL(finished()), SLOT(decodeFinished()));
+    watcher->setFuture(QtConcurrent::mappedReduced(split, decodeRecords, mergeRecords));
+}
+
+void AlarmStore::decodeFinished()
+{
+    QFutureWatcher<QList<AlarmRecord*> > *watcher = 0;
+    foreach (QFutureWatcher<QList<AlarmRecord*> > *w, m_decoding.keys()) {
+        if (w == sender())
+            watcher = w;
+    }
+    if (!watcher)
+        return;
+
+    QMap<uint, QMap<QString,QString> > attributes = m_decoding.take(watcher);
+    watcher->deleteLater();
+    QList<AlarmRecord*> records = watcher->result();
+
+    bool countdown = watcher->property("countdown").toBool();
+    AlarmSet &set = alarmSet(countdown);
+    if (watcher->property("generation").toUInt() != set.generation) {
+        qDeleteAll(records);
+        return;
+    }
+
+    set.decodingCount--;
+    merge(records, attributes);
+    attributesLoaded(countdown);
+}
+
+static QString cacheFilePath(bool countdown)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + (countdown ? QLatin1String("/nemoalarms/countdown.cache") : QLatin1String("/nemoalarms/clock.cache"));
+}
+
+// The cache keeps the decoded records of the alarms that have been saved
+static QDataStream &operator<<(QDataStream &out, const AlarmRecord &record)
+{
+    return out << record.cookie << record.title << record.notebookUid << record.sortKey << record.hour
+               << record.minute << record.second << record.daysOfWeek << record.type << record.enabled
+               << record.countdown << record.triggerTime << record.elapsed << record.timeoutSnoozeCounter
+               << record.maximalTimeoutSnoozeCount << record.partial;
+}
+
+static QDataStream &operator>>(QDataStream &in, AlarmRecord &record)
+{
+    return in >> record.cookie >> record.title >> record.notebookUid >> record.sortKey >> record.hour
+              >> record.minute >> record.second >> record.daysOfWeek >> record.type >> record.enabled
+              >> record.countdown >> record.triggerTime >> record.elapsed >> record.timeoutSnoozeCounter
+              >> record.maximalTimeoutSnoozeCount >> record.partial;
+}
+
+void AlarmStore::loadCache(bool countdown)
+{
+    QFile file(cacheFilePath(countdown));
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0)
+        return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    in >> magic >> version;
+    if (magic == CacheMagic && version == CacheVersion)
+        in >> count;
+
+    // Merged like a reply from timed
+    QMap<uint, QMap<QString,QString> > records;
+    QList<uint> partial;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        AlarmRecord record;
+        in >> record;
+        if (in.status() == QDataStream::Ok) {
+            records.insert(record.cookie, record.attributes());
+            if (record.partial)
+                partial.append(record.cookie);
+        }
+    }
+
+    if (in.status() != QDataStream::Ok || magic != CacheMagic || version != CacheVersion) {
+        qWarning() << "Nemo.Alarms: Ignoring invalid alarm cache" << file.fileName();
+        return;
+    }
+
+    merge(records);
+
+    // The attributes of the record do not tell that there are more
+    foreach (uint cookie, partial) {
+        if (AlarmRecord *record = m_ids.value(cookie))
+            record->partial = true;
+    }
+}
+
+void AlarmStore::saveCache(bool countdown)
+{
+    QList<const AlarmRecord*> records;
+    foreach (const AlarmRecord *record, m_records) {
+        if (record->cookie && record->countdown == countdown)
+            records.append(record);
+    }
+
+    QString path = cacheFilePath(countdown);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Nemo.Alarms: Cannot write alarm cache" << path << file.errorString();
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << CacheMagic << CacheVersion << quint32(records.size());
+    foreach (const AlarmRecord *record, records)
+        out << *record;
+
+    if (!file.commit())
+        qWarning() << "Nemo.Alarms: Cannot write alarm cache" << path << file.errorString();
+}
+
+void AlarmStore::scheduleCacheSave()
+{
+    if (m_cacheEnabled)
+        m_cacheTimer->start();
+}
+
+// Only alarms that have been populated are written; until then the store holds what
+// was read from the cache, along with the alarms fetched so far
+void AlarmStore::saveCaches()
+{
+    for (int countdown = 0; countdown < 2; countdown++) {
+        if (alarmSet(countdown).populated)
+            saveCache(countdown);
+    }
+}
+
+void AlarmStore::attach(AlarmRecord *record, AlarmObject *alarm)
+{
+    record->object = alarm;
+    alarm->setNextTriggerTime(record->nextTriggerTime);
+    m_objects.insert(alarm, record);
+    watch(alarm);
+    connect(alarm, SIGNAL(destroyed(QObject*)), SLOT(objectDestroyed(QObject*)));
+}
+
+// Keep a modified object for as long as its record exists, so that changes which have
+// not been loaded back from timed are not lost
+void AlarmStore::pin(AlarmObject *alarm)
+{
+    if (alarm->parent() == this)
+        return;
+
+    alarm->setParent(this);
+    QQmlEngine::setObjectOwnership(alarm, QQmlEngine::CppOwnership);
+}
+
+void AlarmStore::objectDestroyed(QObject *object)
+{
+    m_objects.remove(object);
+}
+
+// Drop records along with their objects, after the models have been told
+void AlarmStore::remove(const QList<AlarmRecord*> &records)
+{
+    if (records.isEmpty())
+        return;
+
+    QSet<AlarmRecord*> removed;
+    foreach (AlarmRecord *record, records) {
+        removed.insert(record);
+        m_batchUpdated.remove(record);
+        if (record->cookie && m_ids.value(record->cookie) == record)
+            m_ids.remove(record->cookie);
+        if (record->object) {
+            m_objects.remove(record->object);
+            record->object->disconnect(this);
+            record->object->deleteLater();
+        }
+    }
+
+    for (QList<AlarmRecord*>::iterator it = m_records.begin(); it != m_records.end(); ) {
+        if (removed.contains(*it))
+            it = m_records.erase(it);
+        else
+            ++it;
+    }
+
+    emit alarmsRemoved(records);
+    qDeleteAll(records);
+}
+
+// Remove the alarms of the given type whose cookies are not in \a cookies. Alarms which
+// have not been saved yet have no cookie and are left alone.
+void AlarmStore::removeMissing(bool countdown, const QSet<uint> &cookies)
+{
+    QList<AlarmRecord*> removed;
+    foreach (AlarmRecord *record, m_records) {
+        if (record->cookie != 0 && record->countdown == countdown && !cookies.contains(record->cookie))
+            removed.append(record);
+    }
+
+    remove(removed);
+}
+
+// Match the records to the existing alarms by cookie, so that surviving objects and
+// everything bound to them are kept, and add the remaining ones as new alarms. No
+// objects are created for the new alarms.
+void AlarmStore::merge(const QMap<uint, QMap<QString,QString> > &records)
+{
+    QList<AlarmRecord*> changed;
+    QList<AlarmRecord*> added;
+
+    for (QMap<uint, QMap<QString,QString> >::const_iterator it = records.constBegin(); it != records.constEnd(); ++it) {
+        AlarmRecord *record = m_ids.value(it.key());
+        if (record) {
+            // Unsaved edits win, the record already shows them
+            if (record->object && record->object->hasLocalChanges())
+                continue;
+
+            bool modified = record->load(it.value());
+            if (record->object && record->object->reload(it.value()))
+                modified = true;
+            if (modified)
+                changed.append(record);
+        } else {
+            record = new AlarmRecord;
+            record->load(it.value());
+            record->nextTriggerTime = TimedInterface::instance()->triggerSnapshot().value(record->cookie);
+            m_records.append(record);
+            if (record->cookie)
+                m_ids.insert(record->cookie, record);
+            added.append(record);
+        }
+    }
+
+    if (!changed.isEmpty())
+        emit alarmsReloaded(changed);
+    if (!added.isEmpty())
+        emit alarmsInserted(added);
+}
+
+void AlarmStore::alarmTriggerDelta(const TriggerDelta &delta)
+{
+    // Apply the whole delta before notifying; alarmUpdated() only collects the
+    // modified alarms meanwhile, so that the models can handle them in one go.
+    // Cookies that are new, and active alarms that have left the map, are looked up in
+    // timed afterwards: they may have been added or deleted by another process.
+    // The first map is compared with the alarms rather than with an earlier map, like
+    // every map was before deltas
+    QList<quint32> removed = delta.removed;
+    if (delta.initial) {
+        foreach (AlarmRecord *record, m_records) {
+            if (record->cookie && !delta.snapshot.contains(record->cookie))
+                removed.append(record->cookie);
+        }
+    }
+
+    QList<uint> unknown;
+    beginBatchUpdate();
+    foreach (const QList<quint32> &cookies, QList<QList<quint32> >() << removed << delta.added << delta.changed) {
+        foreach (quint32 cookie, cookies) {
+            AlarmRecord *record = m_ids.value(cookie);
+            if (record && setTriggerTime(record, delta.snapshot.value(cookie)))
+                m_batchUpdated.insert(record);
+        }
+    }
+    foreach (quint32 cookie, removed) {
+        AlarmRecord *record = m_ids.value(cookie);
+        // Extra enabling logic is needed for not resetting alarms that were not active
+        if (!record || !record->enabled)
+            continue;
+
+        unknown.append(cookie);
+        setTriggered(record, false);
+    }
+    foreach (quint32 cookie, delta.added) {
+        AlarmRecord *record = m_ids.value(cookie);
+        if (!record) {
+            if (!m_foreignCookies.contains(cookie))
+                unknown.append(cookie);
+        } else if (!record->countdown && !record->enabled) {
+            setTriggered(record, true);
+        }
+    }
+    endBatchUpdate();
+
+    sync(unknown);
+}
+
+// Store the time at which timed triggers the alarm next, 0 if it is not scheduled.
+// Returns whether it changed.
+bool AlarmStore::setTriggerTime(AlarmRecord *record, quint32 triggerTime)
+{
+    if (record->nextTriggerTime == triggerTime)
+        return false;
+
+    record->nextTriggerTime = triggerTime;
+    if (record->object)
+        record->object->setNextTriggerTime(triggerTime);
+    return true;
+}
+
+// Bring an alarm to the enabled state that timed reports for it
+void AlarmStore::setTriggered(AlarmRecord *record, bool enabled)
+{
+    if (record->object) {
+        // This is the state in timed already, it does not need saving. The countdown is
+        // reset first, so that the record does not take the old trigger time from the
+        // updated() signal; a reset without a state change emits nothing at all.
+        if (!enabled)
+            record->object->resetState();
+        record->object->setEnabledState(enabled);
+        if (record->load(record->object))
+            m_batchUpdated.insert(record);
+    } else {
+        record->setEnabled(enabled);
+        m_batchUpdated.insert(record);
+    }
+}
+
+// Merge records decoded in the background from \a records, in sort order. They are taken
+// over by the store or freed.
+void AlarmStore::merge(const QList<AlarmRecord*> &decoded, const QMap<uint, QMap<QString,QString> > &records)
+{
+    QList<AlarmRecord*> changed;
+    QList<AlarmRecord*> added;
+
+    foreach (AlarmRecord *record, decoded) {
+        AlarmRecord *existing = m_ids.value(record->cookie);
+        if (!existing) {
+            record->nextTriggerTime = TimedInterface::instance()->triggerSnapshot().value(record->cookie);
+            m_records.append(record);
+            if (record->cookie)
+                m_ids.insert(record->cookie, record);
+            added.append(record);
+            continue;
+        }
+
+        if (existing->object && existing->object->hasLocalChanges()) {
+            delete record;
+            continue;
+        }
+
+        // Decoded again, so that alarms without a creation date keep theirs
+        const QMap<QString,QString> data = records.value(record->cookie);
+        bool modified = existing->load(data);
+        if (existing->object && existing->object->reload(data))
+            modified = true;
+        if (modified)
+            changed.append(existing);
+        delete record;
+    }
+
+    if (!changed.isEmpty())
+        emit alarmsReloaded(changed);
+    if (!added.isEmpty())
+        emit alarmsInserted(added);
+}
+
+// Fetch the attributes of just these cookies and bring the store in line: alarms of
+// nemoalarms that are not known yet are inserted, known alarms are reloaded, and those
+// that no longer exist are removed
+void AlarmStore::sync(const QList<uint> &cookies)
+{
+    QList<uint> requested;
+    foreach (uint cookie, cookies) {
+        if (!m_syncing.contains(cookie))
+            requested.append(cookie);
+    }
+    if (requested.isEmpty())
+        return;
+
+    foreach (uint cookie, requested)
+        m_syncing.insert(cookie);
+
+    QDBusPendingCall call = TimedInterface::instance()->get_attributes_by_cookies_async(requested);
+    QDBusPendingCallWatcher *reply = new QDBusPendingCallWatcher(call, this);
+    m_syncCalls.insert(reply, requested);
+    connect(reply, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(syncReply(QDBusPendingCallWatcher*)));
+}
+
+void AlarmStore::syncReply(QDBusPendingCallWatcher *call)
+{
+    QDBusPendingReply<QMap<uint, QMap<QString,QString> > > reply = *call;
+    call->deleteLater();
+
+    QList<uint> cookies = m_syncCalls.take(call);
+    foreach (uint cookie, cookies)
+        m_syncing.remove(cookie);
+
+    if (reply.isError()) {
+        qWarning() << "Nemo.Alarms: Timed attributes query failed:" << reply.error();
+        return;
+    }
+
+    QMap<uint, QMap<QString,QString> > events = reply.value();
+    QMap<uint, QMap<QString,QString> > merged;
+    QList<AlarmRecord*> removed;
+    foreach (uint cookie, cookies) {
+        AlarmRecord *record = m_ids.value(cookie);
+        QMap<QString,QString> event = events.value(cookie);
+        if (event.isEmpty()) {
+            // A replaced event is gone as well, its alarm stays while the new one is saved
+            if (record && !(record->object && record->object->isSaving()))
+                removed.append(record);
+        } else if (record) {
+            merged.insert(cookie, event);
+        } else if (event.value(QLatin1String("APPLICATION")) == QLatin1String("nemoalarms")) {
+            merged.insert(cookie, event);
+        } else {
+            m_foreignCookies.insert(cookie);
+        }
+    }
+
+    remove(removed);
+    merge(merged);
+}
+
+void AlarmStore::beginBatchUpdate()
+{
+    m_batchUpdating++;
+}
+
+void AlarmStore::endBatchUpdate()
+{
+    if (--m_batchUpdating > 0 || m_batchUpdated.isEmpty())
+        return;
+
+    QList<AlarmRecord*> changed = m_batchUpdated.values();
+    m_batchUpdated.clear();
+    emit alarmsChanged(changed);
+}
+
+// Called when a next occurrence has been computed for someone to show
+void AlarmStore::occurrenceComputed(qint64 msecs)
+{
+    if (s_instance)
+        s_instance->scheduleOccurrenceUpdate(msecs);
+}
+
+// Arm the timer for the earliest next occurrence that has been read; the occurrences do
+// not change before it passes, unless the alarms are edited or the system time changes.
+// It fires daily at the latest, to keep it from drifting too far off with the clock.
+void AlarmStore::scheduleOccurrenceUpdate(qint64 msecs)
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (msecs <= now || (m_occurrenceTimer->isActive() && m_occurrenceDeadline <= msecs))
+        return;
+
+    m_occurrenceDeadline = msecs;
+    m_occurrenceTimer->start(int(qMin(Q_INT64_C(24) * 60 * 60 * 1000, msecs - now + 1)));
+}
+
+void AlarmStore::updateOccurrences()
+{
+    invalidateOccurrences(QDateTime::currentMSecsSinceEpoch());
+}
+
+// The local time jumped, every occurrence computed so far may be off
+void AlarmStore::resetOccurrences()
+{
+    invalidateOccurrences(std::numeric_limits<qint64>::max());
+}
+
+// Forget the next occurrences up to \a until, notifying about the alarms whose value
+// has been read; they are computed again when next asked for
+void AlarmStore::invalidateOccurrences(qint64 until)
+{
+    m_occurrenceTimer->stop();
+
+    QList<AlarmRecord*> changed;
+    qint64 earliest = 0;
+    foreach (AlarmRecord *record, m_records) {
+        if (record->nextOccurrenceValid && record->nextOccurrenceCache) {
+            if (record->nextOccurrenceCache <= until) {
+                record->invalidateNextOccurrence();
+                changed.append(record);
+            } else if (!earliest || record->nextOccurrenceCache < earliest) {
+                earliest = record->nextOccurrenceCache;
+            }
+        }
+
+        AlarmObject *alarm = record->object;
+        if (alarm && alarm->m_nextOccurrenceValid && alarm->m_nextOccurrence.isValid()) {
+            qint64 next = alarm->m_nextOccurrence.toMSecsSinceEpoch();
+            if (next <= until)
+                alarm->invalidateNextOccurrence();
+            else if (!earliest || next < earliest)
+                earliest = next;
+        }
+    }
+
+    if (earliest)
+        scheduleOccurrenceUpdate(earliest);
+    if (!changed.isEmpty())
+        emit alarmsChanged(changed);
+}
+
+// Write a single alarm for AlarmObject::save(). The store owns the call rather than the
+// object, so that the event created by it is cancelled even if the object is destroyed
+// before the reply, and holds a reference until then.
+void AlarmStore::save(AlarmObject *alarm, Maemo::Timed::Event &ev)
+{
+    TimedInterface *timed = TimedInterface::instance();
+    QDBusPendingCall call = alarm->id() ? timed->replace_event_async(ev, alarm->id()) : timed->add_event_async(ev);
+    QDBusPendingCallWatcher *w = new QDBusPendingCallWatcher(call, this);
+    connect(w, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(saveReply(QDBusPendingCallWatcher*)));
+
+    m_saving[w].append(qMakePair(QPointer<AlarmObject>(alarm), alarm->beginSave()));
+    m_refCount++;
+}
+
+void AlarmStore::saveReply(QDBusPendingCallWatcher *call)
+{
+    QDBusPendingReply<uint> reply = *call;
+    call->deleteLater();
+
+    QPair<QPointer<AlarmObject>, uint> saving = m_saving.take(call).value(0);
+    AlarmObject *alarm = saving.first;
+    if (reply.isError()) {
+        qWarning() << "Nemo.Alarms: Cannot sync alarm to timed:" << reply.error();
+        if (alarm)
+            alarm->setSaveFailed(saving.second);
+    } else if ((!alarm || !alarm->setSaved(reply.value(), saving.second)) && reply.value()) {
+        // The alarm was deleted while saving; its new event goes as well
+        QList<uint> cookies;
+        cookies.append(reply.value());
+        QDBusPendingCallWatcher *w = new QDBusPendingCallWatcher(TimedInterface::instance()->cancel_events_async(cookies), this);
+        connect(w, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(cancelReply(QDBusPendingCallWatcher*)));
+    }
+
+    release();
+}
+
+// Save several alarms with a single call to timed. Like replace_event, saving an alarm
+// that already has a cookie creates a new event; the old events are cancelled once the
+// new ones exist. As with save(), alarms that have not been modified are skipped, and
+// alarms that are being written already save again once that write has completed.
+// Returns 0 if there was nothing to save, or if the events could not be created; \a ok
+// tells which.
+QDBusPendingCallWatcher *AlarmStore::saveAll(const QList<AlarmObject*> &allAlarms, bool *ok)
+{
+    QList<AlarmObject*> alarms;
+    foreach (AlarmObject *alarm, allAlarms) {
+        if (alarm->isSaving())
+            alarm->save();
+        else if (!alarm->id() || alarm->m_dirty)
+            alarms.append(alarm);
+    }
+
+    if (ok)
+        *ok = true;
+    if (alarms.isEmpty())
+        return 0;
+
+    Maemo::Timed::Event::List events;
+    try {
+        foreach (AlarmObject *alarm, alarms)
+            alarm->fillEvent(events.append());
+    } catch (Maemo::Timed::Exception &e) {
+        qWarning() << "Nemo.Alarms: Cannot sync alarms to timed:" << e.what();
+        if (ok)
+            *ok = false;
+        return 0;
+    }
+
+    QDBusPendingCallWatcher *w = new QDBusPendingCallWatcher(TimedInterface::instance()->add_events_async(events), this);
+    connect(w, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(saveAllReply(QDBusPendingCallWatcher*)));
+
+    QList<QPair<QPointer<AlarmObject>, uint> > &saving = m_saving[w];
+    foreach (AlarmObject *alarm, alarms)
+        saving.append(qMakePair(QPointer<AlarmObject>(alarm), alarm->beginSave()));
+    // Held until the reply, as for save()
+    m_refCount++;
+
+    // Update the models right away, as save() does, but in one go
+    beginBatchUpdate();
+    foreach (AlarmObject *alarm, alarms)
+        emit alarm->updated();
+    endBatchUpdate();
+
+    return w;
+}
+
+void AlarmStore::saveAllReply(QDBusPendingCallWatcher *call)
+{
+    QDBusPendingReply<QList<QVariant> > reply = *call;
+    call->deleteLater();
+
+    QList<QPair<QPointer<AlarmObject>, uint> > alarms = m_saving.take(call);
+    if (reply.isError()) {
+        qWarning() << "Nemo.Alarms: Cannot sync alarms to timed:" << reply.error();
+        for (int i = 0; i < alarms.size(); i++) {
+            if (alarms[i].first)
+                alarms[i].first->setSaveFailed(alarms[i].second);
+        }
+        release();
+        return;
+    }
+
+    QList<QVariant> cookies = reply.value();
+    QList<uint> obsolete;
+    for (int i = 0; i < alarms.size() && i < cookies.size(); i++) {
+        AlarmObject *alarm = alarms[i].first;
+        uint generation = alarms[i].second;
+        uint cookie = cookies.at(i).toUInt();
+        if (!cookie) {
+            if (alarm)
+                alarm->setSaveFailed(generation);
+            continue;
+        }
+
+        // The alarm may have been deleted while saving, its new event goes as well
+        uint oldCookie = alarm ? alarm->id() : 0;
+        if (!alarm || !alarm->setSaved(cookie, generation)) {
+            obsolete.append(cookie);
+            continue;
+        }
+
+        if (oldCookie)
+            obsolete.append(oldCookie);
+    }
+
+    if (!obsolete.isEmpty()) {
+        QDBusPendingCallWatcher *w = new QDBusPendingCallWatcher(TimedInterface::instance()->cancel_events_async(obsolete), this);
+        connect(w, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(cancelReply(QDBusPendingCallWatcher*)));
+    }
+
+    release();
+}
+
+// Delete alarms with a single cancel_events call and a single notification to the models
+void AlarmStore::deleteAlarms(const QList<AlarmRecord*> &records)
+{
+    if (records.isEmpty())
+        return;
+
+    QList<uint> cookies;
+    QList<QPointer<AlarmObject> > objects;
+    foreach (AlarmRecord *record, records) {
+        if (record->cookie)
+            cookies.append(record->cookie);
+        if (record->object)
+            objects.append(record->object);
+    }
+
+    if (!cookies.isEmpty()) {
+        QDBusPendingCallWatcher *w = new QDBusPendingCallWatcher(TimedInterface::instance()->cancel_events_async(cookies), this);
+        connect(w, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(cancelReply(QDBusPendingCallWatcher*)));
+    }
+
+    remove(records);
+
+    // The objects are no longer connected to the store, let their users know as
+    // deleteAlarm() would
+    foreach (const QPointer<AlarmObject> &alarm, objects) {
+        if (alarm)
+            alarm->setDeleted();
+    }
+}
+
+void AlarmStore::cancelReply(QDBusPendingCallWatcher *call)
+{
+    QDBusPendingReply<QList<uint> > reply = *call;
+    call->deleteLater();
+
+    if (reply.isError())
+        qWarning() << "Nemo.Alarms: Cannot delete alarms from timed:" << reply.error();
+    else if (!reply.value().isEmpty())
+        qWarning() << "Nemo.Alarms: Cannot delete alarms from timed:" << reply.value();
+}
+
+void AlarmStore::alarmUpdated()
+{
+    AlarmObject *alarm = qobject_cast<AlarmObject*>(sender());
+    if (!alarm)
+        return;
+
+    pin(alarm);
+
+    AlarmRecord *record = m_objects.value(alarm);
+    if (!record) {
+        record = new AlarmRecord;
+        record->load(alarm);
+        record->cookie = alarm->id();
+        record->nextTriggerTime = TimedInterface::instance()->triggerSnapshot().value(record->cookie);
+        attach(record, alarm);
+        m_records.append(record);
+        if (record->cookie)
+            m_ids.insert(record->cookie, record);
+        emit alarmsInserted(QList<AlarmRecord*>() << record);
+        return;
+    }
+
+    record->load(alarm);
+    if (m_batchUpdating) {
+        m_batchUpdated.insert(record);
+    } else {
+        emit alarmsChanged(QList<AlarmRecord*>() << record);
+    }
+}
+
+void AlarmStore::alarmDeleted()
+{
+    AlarmObject *alarm = qobject_cast<AlarmObject*>(sender());
+    if (!alarm)
+        return;
+
+    AlarmRecord *record = m_objects.value(alarm);
+    if (record)
+        remove(QList<AlarmRecord*>() << record);
+    else
+        alarm->deleteLater();
+}
+
+void AlarmStore::alarmIdChanged()
+{
+    AlarmObject *alarm = qobject_cast<AlarmObject*>(sender());
+    AlarmRecord *record = m_objects.value(alarm);
+    if (!alarm || !record || record->cookie == uint(alarm->id()))
+        return;
+
+    if (record->cookie && m_ids.value(record->cookie) == record)
+        m_ids.remove(record->cookie);
+    record->cookie = alarm->id();
+    if (!record->cookie)
+        return;
+
+    // sync() may have picked the new event up from the trigger map before the save
+    // completed; the alarm being saved takes its place
+    AlarmRecord *synced = m_ids.value(record->cookie);
+    if (synced && synced != record)
+        remove(QList<AlarmRecord*>() << synced);
+    m_ids.insert(record->cookie, record);
+    setTriggerTime(record, TimedInterface::instance()->triggerSnapshot().value(record->cookie));
+
+    // Let views that follow alarms by cookie know about the new one
+    emit alarmsChanged(QList<AlarmRecord*>() << record);
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#ifndef ALARMSTORE_H
+#define ALARMSTORE_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QPointer>
+#include <QSet>
+
+#include "interface.h"
+
+class AlarmObject;
+class QDBusPendingCallWatcher;
+class QTimer;
+
+namespace Maemo {
+namespace Timed {
+class Event;
+}
+}
+
+// Compact state of an alarm in the store. Everything that AlarmObject writes back to timed
+// is decoded once, so an object can be created and saved from the record alone; the few
+// attributes that only some alarms have are fetched from timed again for those.
+struct AlarmRecord
+{
+    AlarmRecord();
+
+    bool load(const QMap<QString,QString> &data);
+    bool load(const AlarmObject *alarm);
+    QMap<QString,QString> attributes() const;
+    void setEnabled(bool enabled);
+    qint64 nextOccurrence() const;
+    void invalidateNextOccurrence() { nextOccurrenceValid = false; }
+    bool isRunning() const { return countdown && enabled && triggerTime > 0; }
+    int remaining() const;
+
+    QPointer<AlarmObject> object;
+    QString title;
+    QString notebookUid;
+    quint64 sortKey;
+    uint cookie;
+    quint16 hour;
+    quint8 minute;
+    quint8 second;
+    quint8 daysOfWeek;
+    // AlarmObject::Type
+    quint8 type;
+    bool enabled;
+    bool countdown;
+    // Of countdowns, as in the attributes
+    quint32 triggerTime;
+    quint32 elapsed;
+    quint16 timeoutSnoozeCounter;
+    quint16 maximalTimeoutSnoozeCount;
+    // Has attributes that are not kept here, such as the dates of calendar alarms
+    bool partial;
+    // Of clock alarms, as AlarmObject::nextOccurrence in milliseconds since the epoch;
+    // computed when first read
+    mutable qint64 nextOccurrenceCache;
+    mutable bool nextOccurrenceValid;
+    // From the trigger map of timed, not part of the attributes; 0 if not scheduled
+    quint32 nextTriggerTime;
+};
+
+// Process-wide set of the alarms created by nemoalarms, shared by all AlarmsBackendModel
+// instances. Clock and countdown alarms are loaded separately, when a model first needs
+// them, and are then kept up to date for as long as any model holds a reference.
+class AlarmStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    static AlarmStore *acquire();
+    void release();
+
+    static void occurrenceComputed(qint64 msecs);
+
+    QList<AlarmRecord*> records() const { return m_records; }
+    AlarmRecord *recordById(int id) const;
+    AlarmObject *object(AlarmRecord *record);
+
+    void watch(AlarmObject *alarm);
+
+    bool isPopulated(bool countdown) const;
+    bool isPopulating(bool countdown) const;
+    qreal populationProgress(bool countdown) const;
+
+    int batchSize() const { return m_batchSize; }
+    void setBatchSize(int size);
+
+    bool isCacheEnabled() const { return m_cacheEnabled; }
+    void setCacheEnabled(bool enabled);
+
+    bool isBackgroundDecoding() const { return m_backgroundDecoding; }
+    void setBackgroundDecoding(bool enabled);
+
+    void populate(bool countdown);
+
+    void save(AlarmObject *alarm, Maemo::Timed::Event &ev);
+    QDBusPendingCallWatcher *saveAll(const QList<AlarmObject*> &alarms, bool *ok = 0);
+    void deleteAlarms(const QList<AlarmRecord*> &records);
+
+    // Collect the alarms updated in between and report them with one alarmsChanged().
+    // Batches may be nested.
+    void beginBatchUpdate();
+    void endBatchUpdate();
+
+signals:
+    void alarmsInserted(const QList<AlarmRecord*> &alarms);
+    // The records are freed after this has been emitted
+    void alarmsRemoved(const QList<AlarmRecord*> &alarms);
+    // Alarms modified locally or by a trigger map, or saved with a new cookie
+    void alarmsChanged(const QList<AlarmRecord*> &alarms);
+    // Alarms updated from their attributes in timed
+    void alarmsReloaded(const QList<AlarmRecord*> &alarms);
+    void populatedChanged(bool countdown);
+    void populationProgressChanged(bool countdown);
+
+private slots:
+    void queryReply(QDBusPendingCallWatcher *w);
+    void attributesReply(QDBusPendingCallWatcher *w);
+    void saveReply(QDBusPendingCallWatcher *w);
+    void saveAllReply(QDBusPendingCallWatcher *w);
+    void cancelReply(QDBusPendingCallWatcher *w);
+    void syncReply(QDBusPendingCallWatcher *w);
+    void decodeFinished();
+    void updateOccurrences();
+    void resetOccurrences();
+    void alarmTriggerDelta(const TriggerDelta &delta);
+    void alarmUpdated();
+    void alarmDeleted();
+    void alarmIdChanged();
+    void objectDestroyed(QObject *object);
+    void fetchObjectAttributes();
+    void scheduleCacheSave();
+    void saveCaches();
+
+private:
+    struct AlarmSet {
+        AlarmSet();
+
+        bool populated;
+        bool querying;
+        // Replies to the queries of an earlier population are ignored
+        uint generation;
+        QList<uint> pendingCookies;
+        int fetchingCount;
+        int fetchedCount;
+        int totalCount;
+        // Replies being decoded in the background
+        int decodingCount;
+    };
+
+    AlarmStore();
+    ~AlarmStore();
+
+    AlarmSet &alarmSet(bool countdown) { return m_sets[countdown ? 1 : 0]; }
+    const AlarmSet &alarmSet(bool countdown) const { return m_sets[countdown ? 1 : 0]; }
+
+    void attach(AlarmRecord *record, AlarmObject *alarm);
+    void pin(AlarmObject *alarm);
+    void remove(const QList<AlarmRecord*> &records);
+    void removeMissing(bool countdown, const QSet<uint> &cookies);
+    void merge(const QMap<uint, QMap<QString,QString> > &records);
+    void merge(const QList<AlarmRecord*> &decoded, const QMap<uint, QMap<QString,QString> > &records);
+    void decode(bool countdown, const QMap<uint, QMap<QString,QString> > &records);
+    void fetchMore(bool countdown);
+    void attributesLoaded(bool countdown);
+    void sync(const QList<uint> &cookies);
+    void setTriggered(AlarmRecord *record, bool enabled);
+    bool setTriggerTime(AlarmRecord *record, quint32 triggerTime);
+    void scheduleOccurrenceUpdate(qint64 msecs);
+    void invalidateOccurrences(qint64 until);
+    void loadCache(bool countdown);
+    void saveCache(bool countdown);
+
+    static AlarmStore *s_instance;
+    int m_refCount;
+
+    QList<AlarmRecord*> m_records;
+    // Records by cookie, and by the AlarmObject created for them
+    QHash<int, AlarmRecord*> m_ids;
+    QHash<QObject*, AlarmRecord*> m_objects;
+
+    AlarmSet m_sets[2];
+    int m_batchSize;
+    bool m_cacheEnabled;
+    bool m_backgroundDecoding;
+
+    // Depth of the batch updates in progress, such as while a trigger map is applied;
+    // updated alarms are collected in m_batchUpdated meanwhile
+    int m_batchUpdating;
+    QSet<AlarmRecord*> m_batchUpdated;
+
+    // Alarms of each pending save() and saveAll() with their save generations, in the order
+    // of the events
+    QHash<QDBusPendingCallWatcher*, QList<QPair<QPointer<AlarmObject>, uint> > > m_saving;
+
+    // Cookies of each pending sync(), all of them, and those that turned out to belong
+    // to other applications
+    QHash<QDBusPendingCallWatcher*, QList<uint> > m_syncCalls;
+    QSet<uint> m_syncing;
+    QSet<uint> m_foreignCookies;
+    // Alarms whose objects were just created, their attributes are fetched in one go
+    QList<uint> m_objectCookies;
+
+    // Replies being decoded, kept to reload alarms that exist already
+    QHash<QFutureWatcher<QList<AlarmRecord*> >*, QMap<uint, QMap<QString,QString> > > m_decoding;
+
+    // Fires when the earliest next occurrence that has been read has passed
+    QTimer *m_occurrenceTimer;
+    qint64 m_occurrenceDeadline;
+    // Rewrites the caches once the alarms have stopped changing for a moment
+    QTimer *m_cacheTimer;
+};
+
+#endif
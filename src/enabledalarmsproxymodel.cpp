@@ -37,12 +37,14 @@
 EnabledAlarmsProxyModel::EnabledAlarmsProxyModel(QObject *parent)
     : QSortFilterProxyModel(parent)
 {
+    // QSortFilterProxyModel re-evaluates only the rows covered by a dataChanged() from
+    // the source, and inserts and removes rows as the source does
     setFilterRole(AlarmsBackendModel::EnabledRole);
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    setFilterRegularExpression(QRegularExpression("true"));
-#else
-    setFilterRegExp(QRegExp("true"));
-#endif
+}
+
+bool EnabledAlarmsProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    return sourceModel()->index(sourceRow, 0, sourceParent).data(AlarmsBackendModel::EnabledRole).toBool();
 }
 
 QObject *EnabledAlarmsProxyModel::model() const
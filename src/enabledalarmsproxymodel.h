@@ -47,6 +47,9 @@ public:
     QObject *model() const;
     void setModel(QObject *);
 
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const;
+
 signals:
     void modelChanged();
 };
@@ -1,18 +1,35 @@
 #include <interface.h>
+#include <QTimeZone>
 #include <QTimer>
 
 TimedInterface::TimedInterface()
+    : timezone(QTimeZone::systemTimeZoneId()), signalCount(0), deliveryCount(0)
 {
     timer = new QTimer(this);
     timer->setSingleShot(true);
     timer->setInterval(500);
     connect(timer, SIGNAL(timeout()), this, SLOT(processAlarmTriggers()));
     alarm_triggers_changed_connect(this, SLOT(alarmTriggersChanged(Maemo::Timed::Event::Triggers)));
+    settings_changed_connect(this, SLOT(settingsChanged(Maemo::Timed::WallClock::Info,bool)));
+}
+
+void TimedInterface::settingsChanged(const Maemo::Timed::WallClock::Info &info, bool timeChanged)
+{
+    Q_UNUSED(info);
+    // Other settings, such as the time format, do not affect alarm times. A timezone
+    // change moves local times, even though timed does not report it as a time change.
+    QByteArray zone = QTimeZone::systemTimeZoneId();
+    if (!timeChanged && zone == timezone)
+        return;
+
+    timezone = zone;
+    emit systemTimeChanged();
 }
 
 void TimedInterface::alarmTriggersChanged(Maemo::Timed::Event::Triggers map)
 {
     triggerMap = map;
+    signalCount++;
 
     // Delay forwarding changed triggers, timed may emit alarm_triggers_changed
     // signals in rapid succession
@@ -21,7 +38,44 @@ void TimedInterface::alarmTriggersChanged(Maemo::Timed::Event::Triggers map)
 
 void TimedInterface::processAlarmTriggers()
 {
-    emit alarmTriggersChanged(triggerMap);
+    // Listeners only need to hear about the cookies that changed since the last delivery.
+    // The first map is always delivered, even if it is empty, so that alarms which are no
+    // longer scheduled can be brought up to date.
+    TriggerDelta delta = diff(snapshot, triggerMap);
+    delta.initial = (deliveryCount == 0);
+    if (delta.isEmpty() && !delta.initial)
+        return;
+
+    snapshot = triggerMap;
+    deliveryCount++;
+    emit alarmTriggerDelta(delta);
+    emit alarmTriggersChanged(snapshot);
+}
+
+// Walks both maps in key order, so the cost is linear in their size
+TriggerDelta TimedInterface::diff(const QMap<quint32,quint32> &previous, const QMap<quint32,quint32> &current)
+{
+    TriggerDelta delta;
+    delta.snapshot = current;
+
+    QMap<quint32,quint32>::const_iterator old = previous.constBegin();
+    QMap<quint32,quint32>::const_iterator now = current.constBegin();
+    while (old != previous.constEnd() || now != current.constEnd()) {
+        if (now == current.constEnd() || (old != previous.constEnd() && old.key() < now.key())) {
+            delta.removed.append(old.key());
+            ++old;
+        } else if (old == previous.constEnd() || now.key() < old.key()) {
+            delta.added.append(now.key());
+            ++now;
+        } else {
+            if (old.value() != now.value())
+                delta.changed.append(now.key());
+            ++old;
+            ++now;
+        }
+    }
+
+    return delta;
 }
 
 TimedInterface *TimedInterface::instance()
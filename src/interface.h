@@ -39,29 +39,66 @@
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
 #include <timed-qt6/interface>
+#include <timed-qt6/wallclock>
 #else
 #include <timed-qt5/interface>
+#include <timed-qt5/wallclock>
 #endif
+#include <QList>
 class QTimer;
 
+// Difference between two trigger maps, along with the newer one. The map is implicitly
+// shared between all listeners and is not modified after delivery.
+struct TriggerDelta
+{
+    TriggerDelta() : initial(false) {}
+
+    QMap<quint32,quint32> snapshot;
+    // Cookies that entered the map, left it, or have a new trigger time
+    QList<quint32> added;
+    QList<quint32> removed;
+    QList<quint32> changed;
+    // The first map delivered; cookies missing from it are not listed as removed
+    bool initial;
+
+    bool isEmpty() const { return added.isEmpty() && removed.isEmpty() && changed.isEmpty(); }
+};
+
 class TimedInterface : public Maemo::Timed::Interface
 {
     Q_OBJECT
 public:
     static TimedInterface *instance();
 
+    QMap<quint32,quint32> triggerSnapshot() const { return snapshot; }
+    static TriggerDelta diff(const QMap<quint32,quint32> &previous, const QMap<quint32,quint32> &current);
+
+    // Debounce statistics: trigger maps received from timed, and deliveries made
+    int triggerSignalCount() const { return signalCount; }
+    int triggerDeliveryCount() const { return deliveryCount; }
+
 signals:
     void alarmTriggersChanged(QMap<quint32, quint32>);
+    void alarmTriggerDelta(const TriggerDelta &delta);
+    // The system time or the timezone was changed
+    void systemTimeChanged();
 
 private slots:
     void alarmTriggersChanged(Maemo::Timed::Event::Triggers map);
     void processAlarmTriggers();
+    void settingsChanged(const Maemo::Timed::WallClock::Info &info, bool timeChanged);
 
 private:
     TimedInterface();
 
     QMap<quint32,quint32> triggerMap;
+    // The map delivered last
+    QMap<quint32,quint32> snapshot;
     QTimer *timer;
+    // Timezone when the time settings were last reported
+    QByteArray timezone;
+    int signalCount;
+    int deliveryCount;
 };
 
 #endif
@@ -38,6 +38,8 @@
 
 #include "alarmsbackendmodel.h"
 #include "enabledalarmsproxymodel.h"
+#include "alarmfiltermodel.h"
+#include "upcomingalarmsmodel.h"
 #include "alarmobject.h"
 #include "alarmsettings.h"
 #include "alarmhandlerinterface.h"
@@ -72,6 +74,8 @@ public:
         }
         qmlRegisterType<AlarmsBackendModel>(uri, 1, 0, "AlarmsModel");
         qmlRegisterType<EnabledAlarmsProxyModel>(uri, 1, 0, "EnabledAlarmsProxyModel");
+        qmlRegisterType<AlarmFilterModel>(uri, 1, 0, "AlarmFilterModel");
+        qmlRegisterType<UpcomingAlarmsModel>(uri, 1, 0, "UpcomingAlarmsModel");
         qmlRegisterUncreatableType<AlarmObject>(uri, 1, 0, "Alarm", "Create Alarm via AlarmsModel");
         qmlRegisterType<AlarmHandlerInterface>(uri, 1, 0, "AlarmHandler");
         qmlRegisterType<AlarmSettings>(uri, 1, 0, "AlarmSettings");
@@ -4,7 +4,7 @@ PLUGIN_IMPORT_PATH = Nemo/Alarms
 TEMPLATE = lib
 CONFIG += qt plugin hide_symbols
 QT -= gui
-QT += qml dbus
+QT += qml dbus concurrent
 
 target.path = $$[QT_INSTALL_QML]/$$PLUGIN_IMPORT_PATH
 INSTALLS += target
@@ -30,8 +30,13 @@ DBUS_INTERFACES += timed
 SOURCES += $$SRCDIR/plugin.cpp \
     $$SRCDIR/alarmsbackendmodel.cpp \
     $$SRCDIR/alarmsbackendmodel_p.cpp \
+    $$SRCDIR/alarmstore.cpp \
     $$SRCDIR/enabledalarmsproxymodel.cpp \
+    $$SRCDIR/alarmfiltermodel.cpp \
+    $$SRCDIR/upcomingalarmsmodel.cpp \
+    $$SRCDIR/countdownticker.cpp \
     $$SRCDIR/alarmobject.cpp \
+    $$SRCDIR/alarmattributes.cpp \
     $$SRCDIR/alarmhandlerinterface.cpp \
     $$SRCDIR/alarmdialogobject.cpp \
     $$SRCDIR/alarmsettings.cpp \
@@ -39,8 +44,13 @@ SOURCES += $$SRCDIR/plugin.cpp \
 
 HEADERS += $$SRCDIR/alarmsbackendmodel.h \
     $$SRCDIR/alarmsbackendmodel_p.h \
+    $$SRCDIR/alarmstore.h \
     $$SRCDIR/enabledalarmsproxymodel.h \
+    $$SRCDIR/alarmfiltermodel.h \
+    $$SRCDIR/upcomingalarmsmodel.h \
+    $$SRCDIR/countdownticker.h \
     $$SRCDIR/alarmobject.h \
+    $$SRCDIR/alarmattributes.h \
     $$SRCDIR/alarmhandlerinterface.h \
     $$SRCDIR/alarmdialogobject.h \
     $$SRCDIR/alarmsettings.h \
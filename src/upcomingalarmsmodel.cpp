@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#include "upcomingalarmsmodel.h"
+#include "alarmobject.h"
+#include <algorithm>
+
+/*!
+ *  \qmltype UpcomingAlarmsModel
+ *  \inqmlmodule Nemo.Alarms
+ *
+ *  The next alarms to trigger, soonest first, for views that only need a few of
+ *  them. The trigger times come from the backend; alarms are listed once it has
+ *  reported them.
+ */
+
+UpcomingAlarmsModel::UpcomingAlarmsModel(QObject *parent)
+    : QAbstractListModel(parent), m_store(AlarmStore::acquire()), m_limit(1), m_sequence(0)
+{
+    connect(TimedInterface::instance(), SIGNAL(alarmTriggerDelta(TriggerDelta)),
+            this, SLOT(alarmTriggerDelta(TriggerDelta)));
+    connect(m_store, SIGNAL(alarmsInserted(QList<AlarmRecord*>)), SLOT(alarmsInserted(QList<AlarmRecord*>)));
+    connect(m_store, SIGNAL(alarmsRemoved(QList<AlarmRecord*>)), SLOT(alarmsRemoved(QList<AlarmRecord*>)));
+    connect(m_store, SIGNAL(alarmsChanged(QList<AlarmRecord*>)), SLOT(alarmsChanged(QList<AlarmRecord*>)));
+    connect(m_store, SIGNAL(alarmsReloaded(QList<AlarmRecord*>)), SLOT(alarmsChanged(QList<AlarmRecord*>)));
+
+    // Both types of alarms can be upcoming
+    for (int countdown = 0; countdown < 2; countdown++) {
+        if (!m_store->isPopulated(countdown) && !m_store->isPopulating(countdown))
+            m_store->populate(countdown);
+    }
+
+    alarmsInserted(m_store->records());
+}
+
+UpcomingAlarmsModel::~UpcomingAlarmsModel()
+{
+    m_store->release();
+}
+
+QHash<int, QByteArray> UpcomingAlarmsModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[Qt::DisplayRole] = "title";
+    roles[AlarmObjectRole] = "alarm";
+    roles[TriggerTimeRole] = "triggerTime";
+    return roles;
+}
+
+/*!
+ *  \qmlproperty int UpcomingAlarmsModel::limit
+ *
+ *  The maximum number of alarms in the model. Defaults to 1.
+ */
+void UpcomingAlarmsModel::setLimit(int limit)
+{
+    limit = qMax(0, limit);
+    if (m_limit == limit)
+        return;
+
+    m_limit = limit;
+    updateRows();
+    emit limitChanged();
+}
+
+/*!
+ *  \qmlproperty Alarm UpcomingAlarmsModel::nextAlarm
+ *
+ *  The alarm that triggers next, or null if there is none.
+ */
+QObject *UpcomingAlarmsModel::nextAlarm() const
+{
+    return m_alarms.isEmpty() ? 0 : m_store->object(m_alarms.first());
+}
+
+/*!
+ *  \qmlproperty int UpcomingAlarmsModel::nextTriggerTime
+ *
+ *  When nextAlarm triggers, in seconds since the epoch, or 0 if there is no alarm.
+ */
+uint UpcomingAlarmsModel::nextTriggerTime() const
+{
+    return m_alarmTimes.isEmpty() ? 0 : m_alarmTimes.first();
+}
+
+int UpcomingAlarmsModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_alarms.size();
+}
+
+QVariant UpcomingAlarmsModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_alarms.size())
+        return QVariant();
+
+    AlarmRecord *record = m_alarms[index.row()];
+
+    switch (role) {
+        case Qt::DisplayRole: return record->title;
+        case AlarmObjectRole: return QVariant::fromValue<QObject*>(m_store->object(record));
+        case TriggerTimeRole: return m_alarmTimes[index.row()];
+    }
+
+    return QVariant();
+}
+
+// Heap order for std::push_heap() and std::pop_heap(), which keep the largest on top
+bool UpcomingAlarmsModel::later(const Entry &e1, const Entry &e2)
+{
+    if (e1.triggerTime != e2.triggerTime)
+        return e1.triggerTime > e2.triggerTime;
+    if (e1.cookie != e2.cookie)
+        return e1.cookie > e2.cookie;
+    return e1.sequence > e2.sequence;
+}
+
+void UpcomingAlarmsModel::setTriggerTime(uint cookie, quint32 triggerTime)
+{
+    QHash<uint, Entry>::iterator it = m_entries.find(cookie);
+    if (it != m_entries.end() && it.value().triggerTime == triggerTime)
+        return;
+
+    Entry entry = { triggerTime, cookie, ++m_sequence };
+    m_entries.insert(cookie, entry);
+    m_heap.append(entry);
+    std::push_heap(m_heap.begin(), m_heap.end(), later);
+}
+
+void UpcomingAlarmsModel::removeTriggerTime(uint cookie)
+{
+    m_entries.remove(cookie);
+}
+
+// Rebuild the heap without stale entries once they make up most of it
+void UpcomingAlarmsModel::compact()
+{
+    if (m_heap.size() <= 2 * m_entries.size() + 16)
+        return;
+
+    m_heap.clear();
+    foreach (const Entry &entry, m_entries)
+        m_heap.append(entry);
+    std::make_heap(m_heap.begin(), m_heap.end(), later);
+}
+
+// Take the first alarms off the heap, dropping stale entries on the way, and put them
+// back once the rows are known
+void UpcomingAlarmsModel::updateRows()
+{
+    compact();
+
+    QList<AlarmRecord*> alarms;
+    QList<quint32> times;
+    QVector<Entry> taken;
+    while (!m_heap.isEmpty() && alarms.size() < m_limit) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), later);
+        Entry entry = m_heap.takeLast();
+
+        QHash<uint, Entry>::const_iterator it = m_entries.constFind(entry.cookie);
+        if (it == m_entries.constEnd() || it.value().sequence != entry.sequence)
+            continue;
+
+        AlarmRecord *record = m_store->recordById(entry.cookie);
+        if (!record) {
+            m_entries.remove(entry.cookie);
+            continue;
+        }
+
+        taken.append(entry);
+        alarms.append(record);
+        times.append(entry.triggerTime);
+    }
+    foreach (const Entry &entry, taken) {
+        m_heap.append(entry);
+        std::push_heap(m_heap.begin(), m_heap.end(), later);
+    }
+
+    if (alarms == m_alarms) {
+        if (times != m_alarmTimes) {
+            m_alarmTimes = times;
+            if (!alarms.isEmpty())
+                emit dataChanged(index(0, 0), index(alarms.size() - 1, 0));
+            emit nextAlarmChanged();
+        }
+        return;
+    }
+
+    // There are only a few rows
+    beginResetModel();
+    m_alarms = alarms;
+    m_alarmTimes = times;
+    endResetModel();
+    emit nextAlarmChanged();
+}
+
+void UpcomingAlarmsModel::alarmTriggerDelta(const TriggerDelta &delta)
+{
+    foreach (quint32 cookie, delta.removed)
+        removeTriggerTime(cookie);
+
+    // Only alarms of nemoalarms are tracked; the others become known through the store
+    foreach (quint32 cookie, delta.added + delta.changed) {
+        if (m_store->recordById(cookie))
+            setTriggerTime(cookie, delta.snapshot.value(cookie));
+    }
+
+    updateRows();
+}
+
+void UpcomingAlarmsModel::alarmsInserted(const QList<AlarmRecord*> &alarms)
+{
+    QMap<quint32, quint32> triggers = TimedInterface::instance()->triggerSnapshot();
+    bool added = false;
+    foreach (AlarmRecord *record, alarms) {
+        QMap<quint32, quint32>::const_iterator it = triggers.constFind(record->cookie);
+        if (record->cookie && it != triggers.constEnd()) {
+            setTriggerTime(record->cookie, it.value());
+            added = true;
+        }
+    }
+
+    if (added)
+        updateRows();
+}
+
+void UpcomingAlarmsModel::alarmsRemoved(const QList<AlarmRecord*> &alarms)
+{
+    bool shown = false;
+    foreach (AlarmRecord *record, alarms) {
+        removeTriggerTime(record->cookie);
+        if (m_alarms.contains(record))
+            shown = true;
+    }
+
+    if (!shown)
+        return;
+
+    // The records are freed after this, the rows cannot wait for the next trigger map
+    for (int row = m_alarms.size() - 1; row >= 0; row--) {
+        if (alarms.contains(m_alarms[row])) {
+            beginRemoveRows(QModelIndex(), row, row);
+            m_alarms.removeAt(row);
+            m_alarmTimes.removeAt(row);
+            endRemoveRows();
+        }
+    }
+    updateRows();
+    emit nextAlarmChanged();
+}
+
+// Alarms may have been saved with a new cookie, or have a new title
+void UpcomingAlarmsModel::alarmsChanged(const QList<AlarmRecord*> &alarms)
+{
+    alarmsInserted(alarms);
+
+    foreach (AlarmRecord *record, alarms) {
+        int row = m_alarms.indexOf(record);
+        if (row >= 0)
+            emit dataChanged(index(row, 0), index(row, 0));
+    }
+}
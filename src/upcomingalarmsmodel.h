@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#ifndef UPCOMINGALARMSMODEL_H
+#define UPCOMINGALARMSMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QVector>
+#include <QtQml>
+
+#include "alarmstore.h"
+
+class UpcomingAlarmsModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int limit READ limit WRITE setLimit NOTIFY limitChanged)
+    Q_PROPERTY(QObject *nextAlarm READ nextAlarm NOTIFY nextAlarmChanged)
+    Q_PROPERTY(uint nextTriggerTime READ nextTriggerTime NOTIFY nextAlarmChanged)
+
+public:
+    enum {
+        AlarmObjectRole = Qt::UserRole,
+        TriggerTimeRole
+    };
+
+    UpcomingAlarmsModel(QObject *parent = 0);
+    ~UpcomingAlarmsModel();
+
+    int limit() const { return m_limit; }
+    void setLimit(int limit);
+
+    QObject *nextAlarm() const;
+    uint nextTriggerTime() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role) const;
+
+signals:
+    void limitChanged();
+    void nextAlarmChanged();
+
+protected:
+    QHash<int, QByteArray> roleNames() const;
+
+private slots:
+    void alarmTriggerDelta(const TriggerDelta &delta);
+    void alarmsInserted(const QList<AlarmRecord*> &alarms);
+    void alarmsRemoved(const QList<AlarmRecord*> &alarms);
+    void alarmsChanged(const QList<AlarmRecord*> &alarms);
+
+private:
+    struct Entry {
+        quint32 triggerTime;
+        uint cookie;
+        // Tells a cookie's current entry from earlier ones with the same time
+        quint32 sequence;
+    };
+
+    static bool later(const Entry &e1, const Entry &e2);
+    void setTriggerTime(uint cookie, quint32 triggerTime);
+    void removeTriggerTime(uint cookie);
+    void compact();
+    void updateRows();
+
+    AlarmStore *m_store;
+    int m_limit;
+
+    // Min-heap on trigger time. Entries that are not the current one of their cookie in
+    // m_entries are stale and dropped when they reach the top.
+    QVector<Entry> m_heap;
+    QHash<uint, Entry> m_entries;
+    quint32 m_sequence;
+
+    QList<AlarmRecord*> m_alarms;
+    QList<quint32> m_alarmTimes;
+};
+
+QML_DECLARE_TYPE(UpcomingAlarmsModel)
+
+#endif // UPCOMINGALARMSMODEL_H
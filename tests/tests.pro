@@ -3,7 +3,8 @@ INSTALLLOCATION = /opt/tests/nemo-qml-plugins-qt$${QT_MAJOR_VERSION}/alarms
 
 TEMPLATE = subdirs
 SUBDIRS = tst_alarmsbackendmodel \
-    tst_alarmhandler
+    tst_alarmhandler \
+    tst_alarmobject
 
 tests_xml.target = tests.xml
 tests_xml.depends = $$PWD/tests.xml.in
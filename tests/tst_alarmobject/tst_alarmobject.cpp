@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#include <QObject>
+#include <QtTest>
+
+#include "alarmattributes.h"
+#include "alarmobject.h"
+#include "countdownticker.h"
+
+class tst_AlarmObject : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void attributeKeys();
+    void integers();
+    void loadAttributes();
+    void createdDate();
+    void daysOfWeek();
+    void dirtyTracking();
+    void reloadKeepsEdits();
+    void nextOccurrence();
+    void remaining();
+    void benchmarkKeys_data();
+    void benchmarkKeys();
+    void benchmarkLoad();
+};
+
+// Attributes of a typical clock alarm as returned by timed
+static QMap<QString,QString> clockAttributes()
+{
+    QMap<QString,QString> data;
+    data.insert(QLatin1String("APPLICATION"), QLatin1String("nemoalarms"));
+    data.insert(QLatin1String("COOKIE"), QLatin1String("1234"));
+    data.insert(QLatin1String("STATE"), QLatin1String("ARMED"));
+    data.insert(QLatin1String("TITLE"), QLatin1String("Wake up"));
+    data.insert(QLatin1String("createdDate"), QLatin1String("1700000000000"));
+    data.insert(QLatin1String("daysOfWeek"), QLatin1String("mtwTf"));
+    data.insert(QLatin1String("maximalTimeoutSnoozeCounter"), QLatin1String("2"));
+    data.insert(QLatin1String("timeOfDayWithSeconds"), QLatin1String("25230"));
+    data.insert(QLatin1String("timeoutSnoozeCounter"), QLatin1String("1"));
+    data.insert(QLatin1String("type"), QLatin1String("clock"));
+    return data;
+}
+
+// The comparison chain used before the table-driven decoder, as a baseline
+static int keyByComparison(const QString &key)
+{
+    if (key == "TITLE") return AlarmAttributes::Title;
+    else if (key == "COOKIE") return AlarmAttributes::Cookie;
+    else if (key == "daysOfWeek") return AlarmAttributes::DaysOfWeek;
+    else if (key == "createdDate") return AlarmAttributes::CreatedDate;
+    else if (key == "elapsed") return AlarmAttributes::Elapsed;
+    else if (key == "timeOfDayWithSeconds") return AlarmAttributes::TimeOfDayWithSeconds;
+    else if (key == "timeOfDay") return AlarmAttributes::TimeOfDay;
+    else if (key == "STATE") return AlarmAttributes::State;
+    else if (key == "triggerTime") return AlarmAttributes::TriggerTime;
+    else if (key == "startDate") return AlarmAttributes::StartDate;
+    else if (key == "endDate") return AlarmAttributes::EndDate;
+    else if (key == "uid") return AlarmAttributes::Uid;
+    else if (key == "recurrenceId") return AlarmAttributes::RecurrenceId;
+    else if (key == "timeoutSnoozeCounter") return AlarmAttributes::TimeoutSnoozeCounter;
+    else if (key == "maximalTimeoutSnoozeCounter") return AlarmAttributes::MaximalTimeoutSnoozeCounter;
+    else if (key == "notebook") return AlarmAttributes::Notebook;
+    else if (key == QLatin1String("phoneNumber")) return AlarmAttributes::PhoneNumber;
+    else if (key == QLatin1String("type")) return AlarmAttributes::Type;
+    return AlarmAttributes::Unknown;
+}
+
+void tst_AlarmObject::attributeKeys()
+{
+    const char *names[] = { "TITLE", "COOKIE", "daysOfWeek", "createdDate", "elapsed",
+                            "timeOfDayWithSeconds", "timeOfDay", "STATE", "triggerTime",
+                            "startDate", "endDate", "uid", "recurrenceId", "timeoutSnoozeCounter",
+                            "maximalTimeoutSnoozeCounter", "notebook", "phoneNumber", "type" };
+
+    for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        QString name = QLatin1String(names[i]);
+        QCOMPARE(int(AlarmAttributes::key(name)), keyByComparison(name));
+        QVERIFY(AlarmAttributes::key(name) != AlarmAttributes::Unknown);
+    }
+
+    QCOMPARE(AlarmAttributes::key(QString()), AlarmAttributes::Unknown);
+    QCOMPARE(AlarmAttributes::key(QLatin1String("APPLICATION")), AlarmAttributes::Unknown);
+    QCOMPARE(AlarmAttributes::key(QLatin1String("TITLf")), AlarmAttributes::Unknown);
+    QCOMPARE(AlarmAttributes::key(QLatin1String("title")), AlarmAttributes::Unknown);
+}
+
+void tst_AlarmObject::integers()
+{
+    bool ok = false;
+    QCOMPARE(AlarmAttributes::toInteger(QLatin1String("25230"), &ok), Q_INT64_C(25230));
+    QVERIFY(ok);
+    QCOMPARE(AlarmAttributes::toInteger(QLatin1String("-15"), &ok), Q_INT64_C(-15));
+    QVERIFY(ok);
+    QCOMPARE(AlarmAttributes::toInteger(QLatin1String("1700000000000"), &ok), Q_INT64_C(1700000000000));
+    QVERIFY(ok);
+
+    QCOMPARE(AlarmAttributes::toInteger(QString(), &ok), Q_INT64_C(0));
+    QVERIFY(!ok);
+    QCOMPARE(AlarmAttributes::toInteger(QLatin1String("12a"), &ok), Q_INT64_C(0));
+    QVERIFY(!ok);
+    QCOMPARE(AlarmAttributes::toInteger(QLatin1String("-"), &ok), Q_INT64_C(0));
+    QVERIFY(!ok);
+}
+
+void tst_AlarmObject::loadAttributes()
+{
+    AlarmObject alarm(clockAttributes());
+    QCOMPARE(alarm.id(), 1234);
+    QCOMPARE(alarm.title(), QLatin1String("Wake up"));
+    QCOMPARE(alarm.hour(), 7);
+    QCOMPARE(alarm.minute(), 0);
+    QCOMPARE(alarm.second(), 30);
+    QCOMPARE(alarm.daysOfWeek(), QLatin1String("mtwTf"));
+    QCOMPARE(alarm.isEnabled(), true);
+    QCOMPARE(alarm.isCountdown(), false);
+    QCOMPARE(alarm.timeoutSnoozeCounter(), 1);
+    QCOMPARE(alarm.type(), int(AlarmObject::Clock));
+
+    // Calendar dates are only parsed when asked for
+    QMap<QString,QString> data;
+    data.insert(QLatin1String("startDate"), QLatin1String("2026-01-02T00:00:00"));
+    data.insert(QLatin1String("endDate"), QLatin1String("2026-01-03T00:00:00"));
+    AlarmObject calendar(data);
+    QCOMPARE(calendar.type(), int(AlarmObject::Calendar));
+    QCOMPARE(calendar.startDate(), QDateTime(QDate(2026, 1, 2), QTime(0, 0)));
+    QCOMPARE(calendar.endDate(), QDateTime(QDate(2026, 1, 3), QTime(0, 0)));
+    QCOMPARE(calendar.allDay(), true);
+}
+
+void tst_AlarmObject::createdDate()
+{
+    QMap<QString,QString> data;
+    data.insert(QLatin1String("createdDate"), QLatin1String("1700000000000"));
+    QCOMPARE(AlarmObject(data).createdDate().toMSecsSinceEpoch(), Q_INT64_C(1700000000000));
+
+    // Previous versions stored a stringified QDateTime
+    QDateTime date(QDate(2020, 5, 4), QTime(3, 2, 1));
+    data.insert(QLatin1String("createdDate"), date.toString());
+    QCOMPARE(AlarmObject(data).createdDate(), date);
+}
+
+void tst_AlarmObject::daysOfWeek()
+{
+    AlarmObject alarm;
+    QCOMPARE(alarm.daysOfWeekMask(), 0);
+    QCOMPARE(alarm.daysOfWeek(), QString());
+
+    QSignalSpy spy(&alarm, SIGNAL(daysOfWeekChanged()));
+    alarm.setDaysOfWeek(QLatin1String("Sfm"));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(alarm.daysOfWeekMask(), int(AlarmObject::Monday | AlarmObject::Friday | AlarmObject::Sunday));
+    QCOMPARE(alarm.daysOfWeek(), QLatin1String("mfS"));
+
+    // Invalid strings are ignored
+    alarm.setDaysOfWeek(QLatin1String("mx"));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(alarm.daysOfWeek(), QLatin1String("mfS"));
+
+    alarm.setDaysOfWeekMask(AlarmObject::Tuesday | AlarmObject::Thursday);
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(alarm.daysOfWeek(), QLatin1String("tT"));
+
+    alarm.setDaysOfWeekMask(AlarmObject::Tuesday | AlarmObject::Thursday);
+    QCOMPARE(spy.count(), 2);
+
+    QCOMPARE(AlarmObject(clockAttributes()).daysOfWeekMask(), 0x1f);
+}
+
+void tst_AlarmObject::dirtyTracking()
+{
+    // A new alarm has never been saved, so there is always something to write
+    AlarmObject created;
+    QVERIFY(created.isDirty());
+
+    AlarmObject alarm(clockAttributes());
+    QVERIFY(!alarm.isDirty());
+
+    QSignalSpy spy(&alarm, SIGNAL(dirtyChanged()));
+    alarm.setHour(alarm.hour());
+    alarm.setDaysOfWeekMask(alarm.daysOfWeekMask());
+    alarm.setEnabled(alarm.isEnabled());
+    QVERIFY(!alarm.isDirty());
+    QCOMPARE(spy.count(), 0);
+
+    alarm.setTitle(QLatin1String("Changed"));
+    QVERIFY(alarm.isDirty());
+    QCOMPARE(spy.count(), 1);
+
+    const int minute = alarm.minute();
+    alarm.setMinute((minute + 1) % 60);
+    QVERIFY(alarm.isDirty());
+    QCOMPARE(spy.count(), 1);
+
+    // Fields changed back to the values timed has are not modified any more
+    alarm.setTitle(QLatin1String("Wake up"));
+    QVERIFY(alarm.isDirty());
+    alarm.setMinute(minute);
+    QVERIFY(!alarm.isDirty());
+    QCOMPARE(spy.count(), 2);
+
+    alarm.setEnabled(!alarm.isEnabled());
+    QVERIFY(alarm.isDirty());
+    alarm.setEnabled(!alarm.isEnabled());
+    QVERIFY(!alarm.isDirty());
+    QCOMPARE(spy.count(), 4);
+
+    // Until it is saved, a new alarm has nothing to revert to
+    created.setTitle(QLatin1String("New"));
+    created.setTitle(QString());
+    QVERIFY(created.isDirty());
+}
+
+void tst_AlarmObject::reloadKeepsEdits()
+{
+    QMap<QString,QString> data = clockAttributes();
+    data.insert(QLatin1String("TITLE"), QLatin1String("Changed elsewhere"));
+    data.insert(QLatin1String("timeOfDayWithSeconds"), QLatin1String("30000"));
+
+    // Unsaved edits are not replaced by the backend state
+    AlarmObject edited(clockAttributes());
+    edited.setTitle(QLatin1String("Edited"));
+    QVERIFY(!edited.reload(data));
+    QCOMPARE(edited.title(), QString::fromLatin1("Edited"));
+    QCOMPARE(edited.hour(), 7);
+    QVERIFY(edited.isDirty());
+
+    // Without them the object follows the backend
+    AlarmObject clean(clockAttributes());
+    QSignalSpy spy(&clean, SIGNAL(titleChanged()));
+    QVERIFY(clean.reload(data));
+    QCOMPARE(clean.title(), QString::fromLatin1("Changed elsewhere"));
+    QCOMPARE(clean.hour(), 8);
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(!clean.isDirty());
+}
+
+void tst_AlarmObject::nextOccurrence()
+{
+    // Wednesday
+    const QDateTime from(QDate(2026, 3, 4), QTime(12, 0));
+
+    // Later today, or tomorrow once the time has passed
+    QCOMPARE(AlarmObject::calculateNextOccurrence(13, 30, 0, 0, from), QDateTime(QDate(2026, 3, 4), QTime(13, 30)));
+    QCOMPARE(AlarmObject::calculateNextOccurrence(12, 0, 0, 0, from), QDateTime(QDate(2026, 3, 5), QTime(12, 0)));
+    QCOMPARE(AlarmObject::calculateNextOccurrence(7, 0, 0, AlarmObject::AllDays, from), QDateTime(QDate(2026, 3, 5), QTime(7, 0)));
+
+    // The next day in the mask, wrapping over the week
+    QCOMPARE(AlarmObject::calculateNextOccurrence(7, 0, 0, AlarmObject::Monday | AlarmObject::Friday, from),
+             QDateTime(QDate(2026, 3, 6), QTime(7, 0)));
+    QCOMPARE(AlarmObject::calculateNextOccurrence(7, 0, 0, AlarmObject::Monday, from),
+             QDateTime(QDate(2026, 3, 9), QTime(7, 0)));
+    QCOMPARE(AlarmObject::calculateNextOccurrence(7, 0, 0, AlarmObject::Wednesday, from),
+             QDateTime(QDate(2026, 3, 11), QTime(7, 0)));
+    QCOMPARE(AlarmObject::calculateNextOccurrence(18, 0, 0, AlarmObject::Wednesday, from),
+             QDateTime(QDate(2026, 3, 4), QTime(18, 0)));
+
+    QVERIFY(!AlarmObject::calculateNextOccurrence(25, 0, 0, 0, from).isValid());
+
+    // The property follows edits
+    AlarmObject alarm;
+    QVERIFY(alarm.nextOccurrence() > QDateTime::currentDateTime());
+    QSignalSpy spy(&alarm, SIGNAL(nextOccurrenceChanged()));
+    alarm.setDaysOfWeekMask(AlarmObject::Sunday);
+    QCOMPARE(alarm.nextOccurrence().date().dayOfWeek(), 7);
+    int count = spy.count();
+    QVERIFY(count <= 1);
+    alarm.setHour((alarm.hour() + 1) % 24);
+    QCOMPARE(spy.count(), count + 1);
+    QCOMPARE(alarm.nextOccurrence().time().hour(), alarm.hour());
+
+    // A countdown alarm goes off at its trigger time only while running
+    alarm.setCountdown(true);
+    QVERIFY(!alarm.nextOccurrence().isValid());
+
+    // Nothing is computed or notified until it is read
+    AlarmObject unread;
+    QSignalSpy unreadSpy(&unread, SIGNAL(nextOccurrenceChanged()));
+    unread.setHour(5);
+    unread.setHour(6);
+    QCOMPARE(unreadSpy.count(), 0);
+    QCOMPARE(unread.nextOccurrence().time().hour(), 6);
+}
+
+void tst_AlarmObject::remaining()
+{
+    // A paused countdown has what is left of its duration
+    QCOMPARE(AlarmObject::calculateRemaining(300, 0, 120, 0), 180);
+    QCOMPARE(AlarmObject::calculateRemaining(300, 0, 400, 0), 0);
+
+    // A running one counts down to its trigger time, in whole seconds even if a tick is off
+    QCOMPARE(AlarmObject::calculateRemaining(300, 100000, 0, 40000), 60);
+    QCOMPARE(AlarmObject::calculateRemaining(300, 100000, 0, 40020), 60);
+    QCOMPARE(AlarmObject::calculateRemaining(300, 100000, 0, 39980), 60);
+    QCOMPARE(AlarmObject::calculateRemaining(300, 100000, 0, 200000), 0);
+
+    CountdownTicker *ticker = CountdownTicker::instance();
+    QVERIFY(!ticker->isActive());
+
+    QMap<QString,QString> data;
+    data.insert(QLatin1String("APPLICATION"), QLatin1String("nemoalarms"));
+    data.insert(QLatin1String("STATE"), QLatin1String("ARMED"));
+    data.insert(QLatin1String("timeOfDayWithSeconds"), QLatin1String("60"));
+    data.insert(QLatin1String("triggerTime"),
+                QString::number(QDateTime::currentMSecsSinceEpoch() / 1000 + 30));
+    AlarmObject alarm(data);
+    QVERIFY(alarm.isCountdown());
+    QVERIFY(alarm.remaining() >= 29 && alarm.remaining() <= 31);
+    QVERIFY(ticker->isActive());
+
+    // Two running countdowns share the ticker and change on the same tick
+    AlarmObject other(data);
+    QSignalSpy spy(&alarm, SIGNAL(remainingChanged()));
+    QSignalSpy otherSpy(&other, SIGNAL(remainingChanged()));
+    QSignalSpy tickSpy(ticker, SIGNAL(tick()));
+    int initial = alarm.remaining();
+    QTRY_VERIFY(alarm.remaining() < initial);
+    QCOMPARE(otherSpy.count(), spy.count());
+    QVERIFY(tickSpy.count() >= spy.count());
+
+    // The ticker stops once no countdown is running
+    alarm.setEnabled(false);
+    QVERIFY(ticker->isActive());
+    other.setEnabled(false);
+    QVERIFY(!ticker->isActive());
+    QCOMPARE(AlarmObject(clockAttributes()).remaining(), 0);
+}
+
+void tst_AlarmObject::benchmarkKeys_data()
+{
+    QTest::addColumn<bool>("table");
+    QTest::newRow("comparison chain") << false;
+    QTest::newRow("perfect hash") << true;
+}
+
+void tst_AlarmObject::benchmarkKeys()
+{
+    QFETCH(bool, table);
+
+    const QList<QString> keys = clockAttributes().keys();
+    int sum = 0;
+    if (table) {
+        QBENCHMARK {
+            foreach (const QString &key, keys)
+                sum += AlarmAttributes::key(key);
+        }
+    } else {
+        QBENCHMARK {
+            foreach (const QString &key, keys)
+                sum += keyByComparison(key);
+        }
+    }
+    QVERIFY(sum > 0);
+}
+
+void tst_AlarmObject::benchmarkLoad()
+{
+    const QMap<QString,QString> data = clockAttributes();
+    QBENCHMARK {
+        AlarmObject alarm(data);
+    }
+}
+
+#include "tst_alarmobject.moc"
+QTEST_MAIN(tst_AlarmObject)
@@ -0,0 +1,4 @@
+include(../common.pri)
+TARGET = tst_alarmobject
+
+SOURCES += tst_alarmobject.cpp
@@ -33,7 +33,27 @@
 #include <QtTest>
 
 #include "alarmsbackendmodel.h"
+#include "enabledalarmsproxymodel.h"
+#include "alarmfiltermodel.h"
+#include "upcomingalarmsmodel.h"
 #include "alarmobject.h"
+#include "alarmstore.h"
+#include <QDBusPendingReply>
+
+// Cookies of the events of nemoalarms in timed with the given title
+static QList<uint> eventsTitled(const QString &title)
+{
+    QMap<QString,QVariant> attributes;
+    attributes.insert(QLatin1String("APPLICATION"), "nemoalarms");
+    attributes.insert(QLatin1String("TITLE"), title);
+    QDBusPendingReply<QVariantList> reply = TimedInterface::instance()->query_async(attributes);
+    reply.waitForFinished();
+
+    QList<uint> cookies;
+    foreach (const QVariant &cookie, reply.value())
+        cookies.append(cookie.toUInt());
+    return cookies;
+}
 
 class tst_AlarmsBackendModel : public QObject
 {
@@ -43,6 +63,27 @@ private slots:
     void populated();
     void createAndDelete();
     void setAlarmProperties();
+    void repopulateKeepsObjects();
+    void populateInBatches();
+    void sharedStore();
+    void cachedStartup();
+    void lazyObjects();
+    void saveLazyObject();
+    void saveAll();
+    void deleteAlarms();
+    void deleteDuringSave();
+    void coalescedSave();
+    void switchTypeRepeatedly();
+    void switchTypeFromMemory();
+    void externalChanges();
+    void triggerDelta();
+    void batchedTriggerDelta();
+    void backgroundDecoding();
+    void enabledProxy();
+    void filterModel();
+    void upcomingAlarms();
+    void upcomingReAdded();
+    void nextTriggerTime();
 };
 
 void tst_AlarmsBackendModel::populated()
@@ -90,14 +131,17 @@ void tst_AlarmsBackendModel::createAndDelete()
         }
     }
     QVERIFY(alarmRow >= 0);
+    QCOMPARE(model->rowForId(alarmId), alarmRow);
+    QCOMPARE(model->alarmById(alarmId), alarm);
 
-    // Object will be freed when the model is destroyed
+    // Object will be freed when no model uses the shared store anymore
     {
         QSignalSpy spy(alarm, SIGNAL(destroyed()));
+        model.reset();
+        alarm = 0;
+        QTRY_COMPARE(spy.count(), 1);
         model.reset(new AlarmsBackendModel);
         model->componentComplete();
-        alarm = 0;
-        QCOMPARE(spy.count(), 1);
     }
 
     // Wait to populate
@@ -126,8 +170,11 @@ void tst_AlarmsBackendModel::createAndDelete()
     }
 
     // Removed from model immediately
+    alarmId = alarm->id();
     alarm->deleteAlarm();
     QCOMPARE(model->rowCount(), oldRowCount);
+    QCOMPARE(model->rowForId(alarmId), -1);
+    QVERIFY(!model->alarmById(alarmId));
 }
 
 void tst_AlarmsBackendModel::setAlarmProperties()
@@ -164,5 +211,853 @@ void tst_AlarmsBackendModel::setAlarmProperties()
     alarm->deleteAlarm();
 }
 
+void tst_AlarmsBackendModel::repopulateKeepsObjects()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    AlarmObject *alarm = model->createAlarm();
+    alarm->setTitle(QLatin1String("Test Alarm"));
+    alarm->setHour(7);
+    alarm->save();
+    QTRY_VERIFY(alarm->id() > 0);
+
+    int oldRowCount = model->rowCount();
+    QSignalSpy resetSpy(model.data(), SIGNAL(modelAboutToBeReset()));
+    QSignalSpy destroyedSpy(alarm, SIGNAL(destroyed()));
+
+    // Reloading from timed keeps the existing objects
+    AlarmStore *store = AlarmStore::acquire();
+    store->populate(false);
+    QTRY_VERIFY(!store->isPopulating(false));
+    store->release();
+
+    QCOMPARE(model->rowCount(), oldRowCount);
+    QCOMPARE(resetSpy.count(), 0);
+    QCOMPARE(destroyedSpy.count(), 0);
+    QCOMPARE(model->alarmById(alarm->id()), alarm);
+
+    alarm->deleteAlarm();
+}
+
+void tst_AlarmsBackendModel::populateInBatches()
+{
+    QList<int> ids;
+    {
+        QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+        model->componentComplete();
+        QTRY_COMPARE(model->isPopulated(), true);
+
+        QList<AlarmObject*> created;
+        for (int i = 0; i < 3; i++) {
+            AlarmObject *alarm = model->createAlarm();
+            alarm->setTitle(QLatin1String("Test Alarm"));
+            alarm->setHour(i);
+            alarm->save();
+            created.append(alarm);
+        }
+        foreach (AlarmObject *alarm, created) {
+            QTRY_VERIFY(alarm->id() > 0);
+            ids.append(alarm->id());
+        }
+    }
+
+    // Let the shared store go away, so that the alarms are loaded again
+    QTest::qWait(0);
+
+    QScopedPointer<AlarmsBackendModel> batched(new AlarmsBackendModel);
+    batched->setFetchBatchSize(1);
+    QCOMPARE(batched->fetchBatchSize(), 1);
+    QSignalSpy insertSpy(batched.data(), SIGNAL(rowsInserted(QModelIndex,int,int)));
+    batched->componentComplete();
+    QTRY_COMPARE(batched->isPopulated(), true);
+
+    QCOMPARE(batched->populationProgress(), qreal(1.0));
+    QVERIFY(insertSpy.count() >= ids.count());
+
+    foreach (int id, ids) {
+        AlarmObject *alarm = batched->alarmById(id);
+        QVERIFY(alarm);
+        alarm->deleteAlarm();
+    }
+}
+
+void tst_AlarmsBackendModel::sharedStore()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    AlarmObject *alarm = model->createAlarm();
+    alarm->setTitle(QLatin1String("Test Alarm"));
+    alarm->save();
+    QTRY_VERIFY(alarm->id() > 0);
+
+    // A second model shows the same objects without loading them again
+    QScopedPointer<AlarmsBackendModel> other(new AlarmsBackendModel);
+    other->componentComplete();
+    QCOMPARE(other->isPopulated(), true);
+    QCOMPARE(other->rowCount(), model->rowCount());
+    QCOMPARE(other->alarmById(alarm->id()), alarm);
+
+    // Changes are seen by both models
+    int row = other->rowForId(alarm->id());
+    QSignalSpy spy(other.data(), SIGNAL(dataChanged(QModelIndex,QModelIndex)));
+    alarm->setEnabled(true);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(other->data(other->index(row, 0), AlarmsBackendModel::EnabledRole).toBool(), true);
+
+    int id = alarm->id();
+    alarm->deleteAlarm();
+    QCOMPARE(other->rowCount(), model->rowCount());
+    QCOMPARE(other->rowForId(id), -1);
+}
+
+void tst_AlarmsBackendModel::cachedStartup()
+{
+    int id = 0;
+    {
+        QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+        model->setCacheEnabled(true);
+        model->componentComplete();
+        QTRY_COMPARE(model->isPopulated(), true);
+
+        AlarmObject *alarm = model->createAlarm();
+        alarm->setTitle(QLatin1String("Cached Alarm"));
+        alarm->save();
+        QTRY_VERIFY(alarm->id() > 0);
+        id = alarm->id();
+    }
+
+    // The new alarm is written to the cache when the store is released, if not before,
+    // so a store acquired straight away reads it
+
+    // The cached alarm is shown before timed has replied
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->setCacheEnabled(true);
+    model->componentComplete();
+    QVERIFY(model->rowForId(id) >= 0);
+    QCOMPARE(model->isPopulated(), false);
+
+    QTRY_COMPARE(model->isPopulated(), true);
+    AlarmObject *alarm = model->alarmById(id);
+    QVERIFY(alarm);
+    QCOMPARE(alarm->title(), QLatin1String("Cached Alarm"));
+
+    // Deleting it is written to the cache as well
+    alarm->deleteAlarm();
+    model.reset();
+    QTest::qWait(0);
+
+    model.reset(new AlarmsBackendModel);
+    model->setCacheEnabled(true);
+    model->componentComplete();
+    QCOMPARE(model->rowForId(id), -1);
+    QTRY_COMPARE(model->isPopulated(), true);
+}
+
+void tst_AlarmsBackendModel::lazyObjects()
+{
+    int id = 0;
+    {
+        QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+        model->componentComplete();
+        QTRY_COMPARE(model->isPopulated(), true);
+
+        AlarmObject *alarm = model->createAlarm();
+        alarm->setTitle(QLatin1String("Lazy Alarm"));
+        alarm->setHour(6);
+        alarm->setMinute(15);
+        alarm->setMaximalTimeoutSnoozeCount(3);
+        alarm->save();
+        QTRY_VERIFY(alarm->id() > 0);
+        id = alarm->id();
+    }
+
+    QTest::qWait(0);
+
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    // Roles are served without creating the object
+    AlarmStore *store = AlarmStore::acquire();
+    AlarmRecord *record = store->recordById(id);
+    QVERIFY(record);
+    QModelIndex index = model->index(model->rowForId(id), 0);
+    QCOMPARE(model->data(index, Qt::DisplayRole).toString(), QLatin1String("Lazy Alarm"));
+    QCOMPARE(model->data(index, AlarmsBackendModel::HourRole).toInt(), 6);
+    QCOMPARE(model->data(index, AlarmsBackendModel::MinuteRole).toInt(), 15);
+    QVERIFY(!record->object);
+
+    // The object is created once and then reused
+    AlarmObject *alarm = qobject_cast<AlarmObject*>(model->data(index, AlarmsBackendModel::AlarmObjectRole).value<QObject*>());
+    QVERIFY(alarm);
+    QCOMPARE(alarm->title(), QLatin1String("Lazy Alarm"));
+    QCOMPARE(model->alarmById(id), alarm);
+
+    // The record keeps everything the object saves
+    QCOMPARE(alarm->maximalTimeoutSnoozeCount(), 3);
+    QVERIFY(!alarm->isDirty());
+    store->release();
+
+    alarm->deleteAlarm();
+    QCOMPARE(model->rowForId(id), -1);
+}
+
+void tst_AlarmsBackendModel::saveLazyObject()
+{
+    int id = 0;
+    {
+        QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+        model->componentComplete();
+        QTRY_COMPARE(model->isPopulated(), true);
+
+        AlarmObject *alarm = model->createAlarm();
+        alarm->setTitle(QLatin1String("Lazy Save"));
+        alarm->setHour(7);
+        alarm->setMaximalTimeoutSnoozeCount(3);
+        alarm->save();
+        QTRY_VERIFY(alarm->id() > 0);
+        id = alarm->id();
+    }
+
+    QTest::qWait(0);
+
+    {
+        QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+        model->componentComplete();
+        QTRY_COMPARE(model->isPopulated(), true);
+
+        // Saved before anything else could be heard from timed
+        AlarmObject *alarm = model->alarmById(id);
+        QVERIFY(alarm);
+        QSignalSpy savedSpy(alarm, SIGNAL(saved()));
+        alarm->setMinute(30);
+        alarm->save();
+        QTRY_COMPARE(savedSpy.count(), 1);
+        id = alarm->id();
+    }
+
+    QTest::qWait(0);
+
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    AlarmObject *alarm = model->alarmById(id);
+    QVERIFY(alarm);
+    QCOMPARE(alarm->minute(), 30);
+    QCOMPARE(alarm->maximalTimeoutSnoozeCount(), 3);
+
+    alarm->deleteAlarm();
+    QCOMPARE(model->rowForId(id), -1);
+}
+
+void tst_AlarmsBackendModel::saveAll()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    int oldRowCount = model->rowCount();
+    QVariantList alarms;
+    for (int i = 0; i < 3; i++) {
+        AlarmObject *alarm = model->createAlarm();
+        alarm->setTitle(QLatin1String("Batch Alarm"));
+        alarm->setHour(i + 1);
+        alarms.append(QVariant::fromValue<QObject*>(alarm));
+    }
+
+    // All alarms are shown immediately and saved with one request
+    QSignalSpy finishedSpy(model.data(), SIGNAL(saveAllFinished(bool)));
+    model->saveAll(alarms);
+    QCOMPARE(model->rowCount(), oldRowCount + 3);
+    QTRY_COMPARE(finishedSpy.count(), 1);
+    QCOMPARE(finishedSpy.first().first().toBool(), true);
+
+    QSet<int> ids;
+    foreach (const QVariant &value, alarms) {
+        AlarmObject *alarm = qobject_cast<AlarmObject*>(value.value<QObject*>());
+        QVERIFY(alarm->id() > 0);
+        QVERIFY(model->rowForId(alarm->id()) >= 0);
+        ids.insert(alarm->id());
+    }
+    QCOMPARE(ids.count(), 3);
+
+    // Saving again replaces the events
+    foreach (const QVariant &value, alarms)
+        qobject_cast<AlarmObject*>(value.value<QObject*>())->setMinute(30);
+    model->saveAll(alarms);
+    QTRY_COMPARE(finishedSpy.count(), 2);
+    QCOMPARE(model->rowCount(), oldRowCount + 3);
+
+    foreach (const QVariant &value, alarms) {
+        AlarmObject *alarm = qobject_cast<AlarmObject*>(value.value<QObject*>());
+        QVERIFY(!ids.contains(alarm->id()));
+        QCOMPARE(model->alarmById(alarm->id()), alarm);
+        alarm->deleteAlarm();
+    }
+    QCOMPARE(model->rowCount(), oldRowCount);
+}
+
+void tst_AlarmsBackendModel::deleteAlarms()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    int oldRowCount = model->rowCount();
+    QVariantList alarms;
+    for (int i = 0; i < 5; i++) {
+        AlarmObject *alarm = model->createAlarm();
+        alarm->setTitle(QLatin1String("Deleted Alarm"));
+        alarm->setHour(23);
+        alarm->setMinute(59);
+        alarms.append(QVariant::fromValue<QObject*>(alarm));
+    }
+
+    QSignalSpy finishedSpy(model.data(), SIGNAL(saveAllFinished(bool)));
+    model->saveAll(alarms);
+    QTRY_COMPARE(finishedSpy.count(), 1);
+
+    QVariantList ids;
+    foreach (const QVariant &value, alarms)
+        ids.append(qobject_cast<AlarmObject*>(value.value<QObject*>())->id());
+
+    // One of them through removeRows()
+    AlarmObject *first = qobject_cast<AlarmObject*>(alarms.first().value<QObject*>());
+    QSignalSpy deletedSpy(first, SIGNAL(deleted()));
+    QVERIFY(model->removeRows(model->rowForId(first->id()), 1));
+    QCOMPARE(deletedSpy.count(), 1);
+    QCOMPARE(model->rowCount(), oldRowCount + 4);
+
+    // The rest in one go; they are sorted next to each other
+    QSignalSpy removedSpy(model.data(), SIGNAL(rowsRemoved(QModelIndex,int,int)));
+    model->deleteAlarms(ids);
+    QCOMPARE(removedSpy.count(), 1);
+    QCOMPARE(model->rowCount(), oldRowCount);
+    foreach (const QVariant &id, ids)
+        QCOMPARE(model->rowForId(id.toInt()), -1);
+
+    QVERIFY(!model->removeRows(model->rowCount(), 1));
+}
+
+void tst_AlarmsBackendModel::deleteDuringSave()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+    int oldRowCount = model->rowCount();
+
+    // Deleted before timed has replied with the cookie
+    AlarmObject *alarm = model->createAlarm();
+    alarm->setTitle(QLatin1String("Deleted While Saving"));
+    alarm->setHour(22);
+    alarm->save();
+    alarm->deleteAlarm();
+    QCOMPARE(model->rowCount(), oldRowCount);
+
+    // Destroyed before the reply; the store completes the write without it
+    QPointer<AlarmObject> destroyed(new AlarmObject);
+    destroyed->setTitle(QLatin1String("Destroyed While Saving"));
+    destroyed->setHour(22);
+    destroyed->save();
+    delete destroyed.data();
+    QVERIFY(!destroyed);
+
+    // The events created for them are cancelled once the replies arrive
+    QTest::qWait(1000);
+    QTRY_VERIFY(eventsTitled(QLatin1String("Deleted While Saving")).isEmpty());
+    QTRY_VERIFY(eventsTitled(QLatin1String("Destroyed While Saving")).isEmpty());
+    QCOMPARE(model->rowCount(), oldRowCount);
+}
+
+void tst_AlarmsBackendModel::coalescedSave()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    AlarmObject *alarm = model->createAlarm();
+    alarm->setTitle(QLatin1String("Toggled Alarm"));
+    alarm->setHour(6);
+    QSignalSpy savedSpy(alarm, SIGNAL(saved()));
+    alarm->save();
+    QTRY_COMPARE(savedSpy.count(), 1);
+
+    // Quick toggles while the first write is in flight end up in one follow-up write
+    for (int i = 0; i < 5; i++) {
+        alarm->setEnabled(!alarm->isEnabled());
+        alarm->save();
+    }
+    QTRY_COMPARE(savedSpy.count(), 3);
+    QTest::qWait(500);
+    QCOMPARE(savedSpy.count(), 3);
+    QVERIFY(!alarm->isDirty());
+    QCOMPARE(alarm->isEnabled(), true);
+    QCOMPARE(model->alarmById(alarm->id()), alarm);
+
+    alarm->deleteAlarm();
+}
+
+void tst_AlarmsBackendModel::switchTypeRepeatedly()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    // Only the last type requested is loaded, with a single reset
+    QSignalSpy resetSpy(model.data(), SIGNAL(modelReset()));
+    for (int i = 0; i < 11; i++)
+        model->setOnlyCountdown(!model->isOnlyCountdown());
+    QCOMPARE(model->isOnlyCountdown(), true);
+    QTest::qWait(500);
+    QCOMPARE(resetSpy.count(), 1);
+
+    for (int i = 0; i < model->rowCount(); i++) {
+        AlarmObject *alarm = qobject_cast<AlarmObject*>(model->data(model->index(i, 0), AlarmsBackendModel::AlarmObjectRole).value<QObject*>());
+        QVERIFY(alarm->isCountdown());
+    }
+
+    // Ending up with the type already shown does not reset at all
+    for (int i = 0; i < 10; i++)
+        model->setOnlyCountdown(!model->isOnlyCountdown());
+    QTest::qWait(500);
+    QCOMPARE(resetSpy.count(), 1);
+}
+
+void tst_AlarmsBackendModel::switchTypeFromMemory()
+{
+    AlarmStore *store = AlarmStore::acquire();
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    // The countdown alarms are loaded in the background without switching
+    QTRY_COMPARE(store->isPopulated(true), true);
+    QCOMPARE(store->isPopulating(true), false);
+
+    int countdowns = 0;
+    foreach (AlarmRecord *record, store->records()) {
+        if (record->countdown)
+            countdowns++;
+    }
+
+    // Switching only swaps the rows; nothing is left to load
+    model->setOnlyCountdown(true);
+    QCoreApplication::processEvents();
+    QCOMPARE(model->rowCount(), countdowns);
+    QCOMPARE(model->populationProgress(), qreal(1.0));
+    QCOMPARE(store->isPopulating(true), false);
+
+    model.reset();
+    store->release();
+}
+
+void tst_AlarmsBackendModel::externalChanges()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+    int oldRowCount = model->rowCount();
+
+    // An alarm the model does not know about, as if saved by another process
+    QScopedPointer<AlarmObject> external(new AlarmObject);
+    external->setTitle(QLatin1String("External Alarm"));
+    external->setHour(4);
+    external->setEnabled(true);
+    QSignalSpy savedSpy(external.data(), SIGNAL(saved()));
+    external->save();
+    QTRY_COMPARE(savedSpy.count(), 1);
+
+    // It is picked up from the trigger map without populating again
+    QTRY_VERIFY(model->rowForId(external->id()) >= 0);
+    QCOMPARE(model->rowCount(), oldRowCount + 1);
+    AlarmObject *alarm = model->alarmById(external->id());
+    QVERIFY(alarm != external.data());
+    QCOMPARE(alarm->title(), external->title());
+
+    int row = model->rowForId(external->id());
+    if (row > 0)
+        QVERIFY(model->data(model->index(row - 1, 0), AlarmsBackendModel::HourRole).toInt() <= 4);
+    if (row < model->rowCount() - 1)
+        QVERIFY(model->data(model->index(row + 1, 0), AlarmsBackendModel::HourRole).toInt() >= 4);
+
+    // Deleting it elsewhere removes the row
+    int id = external->id();
+    external->deleteAlarm();
+    QTRY_COMPARE(model->rowForId(id), -1);
+    QCOMPARE(model->rowCount(), oldRowCount);
+}
+
+void tst_AlarmsBackendModel::triggerDelta()
+{
+    QMap<quint32,quint32> previous;
+    previous.insert(1, 100);
+    previous.insert(2, 200);
+    previous.insert(4, 400);
+
+    QMap<quint32,quint32> current;
+    current.insert(2, 250);
+    current.insert(3, 300);
+    current.insert(4, 400);
+    current.insert(5, 500);
+
+    TriggerDelta delta = TimedInterface::diff(previous, current);
+    QCOMPARE(delta.added, QList<quint32>() << 3 << 5);
+    QCOMPARE(delta.removed, QList<quint32>() << 1);
+    QCOMPARE(delta.changed, QList<quint32>() << 2);
+    QCOMPARE(delta.snapshot, current);
+    QVERIFY(!delta.initial);
+
+    QVERIFY(TimedInterface::diff(current, current).isEmpty());
+    QCOMPARE(TimedInterface::diff(QMap<quint32,quint32>(), current).added.size(), 4);
+    QCOMPARE(TimedInterface::diff(current, QMap<quint32,quint32>()).removed.size(), 4);
+
+    // Deliveries are debounced, there can never be more than trigger maps received
+    TimedInterface *timed = TimedInterface::instance();
+    QVERIFY(timed->triggerDeliveryCount() <= timed->triggerSignalCount());
+}
+
+void tst_AlarmsBackendModel::batchedTriggerDelta()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->setOnlyCountdown(true);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    QVariantList alarms;
+    for (int i = 0; i < 3; i++) {
+        AlarmObject *alarm = model->createAlarm();
+        alarm->setTitle(QLatin1String("Triggered Countdown"));
+        alarm->setCountdown(true);
+        alarm->setHour(23);
+        alarm->setMinute(57 + i);
+        alarm->setEnabled(true);
+        alarms.append(QVariant::fromValue<QObject*>(alarm));
+    }
+
+    QSignalSpy finishedSpy(model.data(), SIGNAL(saveAllFinished(bool)));
+    model->saveAll(alarms);
+    QTRY_COMPARE(finishedSpy.count(), 1);
+
+    QVariantList ids;
+    TriggerDelta delta;
+    foreach (const QVariant &value, alarms) {
+        AlarmObject *alarm = qobject_cast<AlarmObject*>(value.value<QObject*>());
+        QVERIFY(alarm->triggerTime() > 0);
+        ids.append(alarm->id());
+        delta.removed << alarm->id();
+    }
+
+    // Countdowns that have triggered leave the map together and are handled in one go
+    QSignalSpy layoutSpy(model.data(), SIGNAL(layoutChanged()));
+    QSignalSpy movedSpy(model.data(), SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)));
+    QSignalSpy changedSpy(model.data(), SIGNAL(dataChanged(QModelIndex,QModelIndex)));
+    AlarmStore *store = AlarmStore::acquire();
+    QVERIFY(QMetaObject::invokeMethod(store, "alarmTriggerDelta", Q_ARG(TriggerDelta, delta)));
+    QVERIFY(layoutSpy.count() <= 1);
+    QCOMPARE(movedSpy.count(), 0);
+    // The rows are next to each other
+    QCOMPARE(changedSpy.count(), 1);
+
+    // The records are reset along with their objects
+    foreach (const QVariant &id, ids) {
+        AlarmRecord *record = store->recordById(id.toInt());
+        QVERIFY(record);
+        QVERIFY(!record->enabled);
+        QCOMPARE(record->triggerTime, 0u);
+        QCOMPARE(record->elapsed, 0u);
+        QCOMPARE(model->data(model->index(model->rowForId(id.toInt()), 0), AlarmsBackendModel::EnabledRole).toBool(), false);
+    }
+    store->release();
+
+    model->deleteAlarms(ids);
+}
+
+void tst_AlarmsBackendModel::backgroundDecoding()
+{
+    QList<int> ids;
+    {
+        QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+        model->componentComplete();
+        QTRY_COMPARE(model->isPopulated(), true);
+
+        QVariantList alarms;
+        for (int i = 0; i < 200; i++) {
+            AlarmObject *alarm = model->createAlarm();
+            alarm->setTitle(QLatin1String("Decoded Alarm"));
+            alarm->setHour((i * 7) % 24);
+            alarm->setMinute(i % 60);
+            alarms.append(QVariant::fromValue<QObject*>(alarm));
+        }
+        QSignalSpy finishedSpy(model.data(), SIGNAL(saveAllFinished(bool)));
+        model->saveAll(alarms);
+        QTRY_COMPARE(finishedSpy.count(), 1);
+        foreach (const QVariant &value, alarms)
+            ids.append(qobject_cast<AlarmObject*>(value.value<QObject*>())->id());
+    }
+
+    // Let the shared store go away, so that the alarms are loaded again
+    QTest::qWait(0);
+
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->setBackgroundDecoding(true);
+    QSignalSpy insertSpy(model.data(), SIGNAL(rowsInserted(QModelIndex,int,int)));
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    // The sorted records of the reply are inserted in one go
+    QCOMPARE(insertSpy.count(), 1);
+    foreach (int id, ids)
+        QVERIFY(model->rowForId(id) >= 0);
+
+    for (int row = 1; row < model->rowCount(); row++) {
+        int previous = model->data(model->index(row - 1, 0), AlarmsBackendModel::HourRole).toInt() * 60
+                + model->data(model->index(row - 1, 0), AlarmsBackendModel::MinuteRole).toInt();
+        int current = model->data(model->index(row, 0), AlarmsBackendModel::HourRole).toInt() * 60
+                + model->data(model->index(row, 0), AlarmsBackendModel::MinuteRole).toInt();
+        QVERIFY(previous <= current);
+    }
+
+    QVariantList deleted;
+    foreach (int id, ids)
+        deleted.append(id);
+    model->deleteAlarms(deleted);
+}
+
+void tst_AlarmsBackendModel::enabledProxy()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    EnabledAlarmsProxyModel proxy;
+    proxy.setModel(model.data());
+    int enabledCount = 0;
+    for (int i = 0; i < model->rowCount(); i++) {
+        if (model->data(model->index(i, 0), AlarmsBackendModel::EnabledRole).toBool())
+            enabledCount++;
+    }
+    QCOMPARE(proxy.rowCount(), enabledCount);
+
+    AlarmObject *alarm = model->createAlarm();
+    alarm->setTitle(QLatin1String("Proxied Alarm"));
+    alarm->save();
+    QTRY_VERIFY(alarm->id() > 0);
+    QCOMPARE(proxy.rowCount(), enabledCount);
+
+    // Toggling one alarm only adds or removes its row
+    QSignalSpy resetSpy(&proxy, SIGNAL(modelReset()));
+    QSignalSpy layoutSpy(&proxy, SIGNAL(layoutChanged()));
+    QSignalSpy insertSpy(&proxy, SIGNAL(rowsInserted(QModelIndex,int,int)));
+    QSignalSpy removeSpy(&proxy, SIGNAL(rowsRemoved(QModelIndex,int,int)));
+
+    alarm->setEnabled(true);
+    alarm->save();
+    QCOMPARE(proxy.rowCount(), enabledCount + 1);
+    QCOMPARE(insertSpy.count(), 1);
+
+    alarm->setEnabled(false);
+    alarm->save();
+    QCOMPARE(proxy.rowCount(), enabledCount);
+    QCOMPARE(removeSpy.count(), 1);
+
+    QCOMPARE(resetSpy.count(), 0);
+    QCOMPARE(layoutSpy.count(), 0);
+
+    QTRY_VERIFY(!alarm->isDirty());
+    alarm->deleteAlarm();
+}
+
+void tst_AlarmsBackendModel::filterModel()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    QVariantList alarms;
+    for (int i = 0; i < 4; i++) {
+        AlarmObject *alarm = model->createAlarm();
+        alarm->setTitle(QString(QLatin1String("Filtered Alarm %1")).arg(i));
+        alarm->setHour(6 + i);
+        alarm->setDaysOfWeekMask(i % 2 ? AlarmObject::Saturday : AlarmObject::Monday);
+        alarm->setEnabled(i < 2);
+        alarms.append(QVariant::fromValue<QObject*>(alarm));
+    }
+    QSignalSpy finishedSpy(model.data(), SIGNAL(saveAllFinished(bool)));
+    model->saveAll(alarms);
+    QTRY_COMPARE(finishedSpy.count(), 1);
+
+    AlarmFilterModel filter;
+    filter.setModel(model.data());
+    QCOMPARE(filter.rowCount(), model->rowCount());
+
+    filter.setTitleFilter(QLatin1String("filtered alarm"));
+    QCOMPARE(filter.rowCount(), 4);
+
+    // Criteria combine
+    filter.setEnabledState(AlarmFilterModel::EnabledOnly);
+    QCOMPARE(filter.rowCount(), 2);
+    filter.setDaysOfWeekMask(AlarmObject::Saturday | AlarmObject::Sunday);
+    QCOMPARE(filter.rowCount(), 1);
+    filter.setEnabledState(AlarmFilterModel::AnyState);
+    QCOMPARE(filter.rowCount(), 2);
+
+    filter.setDaysOfWeekMask(0);
+    filter.setTimeRangeStart(7 * 60);
+    filter.setTimeRangeEnd(8 * 60 + 59);
+    QCOMPARE(filter.rowCount(), 2);
+    filter.setAlarmType(AlarmObject::Countdown);
+    QCOMPARE(filter.rowCount(), 0);
+    filter.setAlarmType(AlarmObject::Clock);
+    QCOMPARE(filter.rowCount(), 2);
+
+    // Changes to the alarms update the rows they affect
+    AlarmObject *alarm = qobject_cast<AlarmObject*>(alarms.first().value<QObject*>());
+    alarm->setHour(7);
+    alarm->save();
+    QCOMPARE(filter.rowCount(), 3);
+
+    filter.setNotebookUid(QLatin1String("no-such-notebook"));
+    QCOMPARE(filter.rowCount(), 0);
+
+    QVariantList ids;
+    foreach (const QVariant &value, alarms)
+        ids.append(qobject_cast<AlarmObject*>(value.value<QObject*>())->id());
+    model->deleteAlarms(ids);
+    filter.setNotebookUid(QString());
+    QCOMPARE(filter.rowCount(), 0);
+}
+
+void tst_AlarmsBackendModel::upcomingAlarms()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    UpcomingAlarmsModel upcoming;
+    upcoming.setLimit(100);
+
+    QVariantList alarms;
+    QList<int> ids;
+    for (int i = 0; i < 2; i++) {
+        AlarmObject *alarm = model->createAlarm();
+        alarm->setTitle(QLatin1String("Upcoming Alarm"));
+        alarm->setHour(3 + i);
+        alarm->setEnabled(true);
+        alarms.append(QVariant::fromValue<QObject*>(alarm));
+    }
+    QSignalSpy finishedSpy(model.data(), SIGNAL(saveAllFinished(bool)));
+    model->saveAll(alarms);
+    QTRY_COMPARE(finishedSpy.count(), 1);
+    foreach (const QVariant &value, alarms)
+        ids.append(qobject_cast<AlarmObject*>(value.value<QObject*>())->id());
+
+    // The alarms are listed once timed reports their trigger times, soonest first
+    QTRY_VERIFY(upcoming.rowCount() >= 2);
+    QList<int> listed;
+    for (int row = 0; row < upcoming.rowCount(); row++) {
+        QModelIndex index = upcoming.index(row, 0);
+        AlarmObject *alarm = qobject_cast<AlarmObject*>(upcoming.data(index, UpcomingAlarmsModel::AlarmObjectRole).value<QObject*>());
+        listed.append(alarm->id());
+        if (row > 0)
+            QVERIFY(upcoming.data(upcoming.index(row - 1, 0), UpcomingAlarmsModel::TriggerTimeRole).toUInt()
+                    <= upcoming.data(index, UpcomingAlarmsModel::TriggerTimeRole).toUInt());
+    }
+    foreach (int id, ids)
+        QVERIFY(listed.contains(id));
+
+    upcoming.setLimit(1);
+    QCOMPARE(upcoming.rowCount(), 1);
+    QCOMPARE(qobject_cast<AlarmObject*>(upcoming.nextAlarm())->id(), listed.first());
+    QCOMPARE(upcoming.nextTriggerTime(), upcoming.data(upcoming.index(0, 0), UpcomingAlarmsModel::TriggerTimeRole).toUInt());
+
+    // Deleted alarms leave the model right away
+    QVariantList deleted;
+    foreach (int id, ids)
+        deleted.append(id);
+    model->deleteAlarms(deleted);
+    upcoming.setLimit(100);
+    for (int row = 0; row < upcoming.rowCount(); row++) {
+        AlarmObject *alarm = qobject_cast<AlarmObject*>(upcoming.data(upcoming.index(row, 0), UpcomingAlarmsModel::AlarmObjectRole).value<QObject*>());
+        QVERIFY(!ids.contains(alarm->id()));
+    }
+}
+
+void tst_AlarmsBackendModel::upcomingReAdded()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    // Disabled, so that timed never reports a trigger time of its own for it
+    AlarmObject *alarm = model->createAlarm();
+    alarm->setTitle(QLatin1String("Re-added Alarm"));
+    alarm->setEnabled(false);
+    alarm->save();
+    QTRY_VERIFY(alarm->id() > 0);
+    QTRY_VERIFY(model->rowForId(alarm->id()) >= 0);
+    quint32 cookie = alarm->id();
+
+    UpcomingAlarmsModel upcoming;
+    upcoming.setLimit(100);
+
+    // Leaving and re-entering the trigger map with the same time must not list it twice
+    TriggerDelta added;
+    added.snapshot.insert(cookie, 1);
+    added.added << cookie;
+    TriggerDelta removed;
+    removed.removed << cookie;
+    QVERIFY(QMetaObject::invokeMethod(&upcoming, "alarmTriggerDelta", Q_ARG(TriggerDelta, added)));
+    QVERIFY(QMetaObject::invokeMethod(&upcoming, "alarmTriggerDelta", Q_ARG(TriggerDelta, removed)));
+    QVERIFY(QMetaObject::invokeMethod(&upcoming, "alarmTriggerDelta", Q_ARG(TriggerDelta, added)));
+
+    int count = 0;
+    for (int row = 0; row < upcoming.rowCount(); row++) {
+        AlarmObject *listed = qobject_cast<AlarmObject*>(upcoming.data(upcoming.index(row, 0), UpcomingAlarmsModel::AlarmObjectRole).value<QObject*>());
+        if (listed->id() == alarm->id())
+            count++;
+    }
+    QCOMPARE(count, 1);
+    QCOMPARE(qobject_cast<AlarmObject*>(upcoming.nextAlarm())->id(), alarm->id());
+
+    alarm->deleteAlarm();
+}
+
+void tst_AlarmsBackendModel::nextTriggerTime()
+{
+    QScopedPointer<AlarmsBackendModel> model(new AlarmsBackendModel);
+    model->componentComplete();
+    QTRY_COMPARE(model->isPopulated(), true);
+
+    AlarmObject *alarm = model->createAlarm();
+    alarm->setTitle(QLatin1String("Triggered Alarm"));
+    alarm->setHour(5);
+    alarm->setEnabled(true);
+    QCOMPARE(alarm->nextTriggerTime(), 0u);
+
+    QSignalSpy spy(alarm, SIGNAL(nextTriggerTimeChanged()));
+    alarm->save();
+    QTRY_VERIFY(alarm->nextTriggerTime() > 0);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(alarm->nextTriggerTime(), uint(alarm->nextOccurrence().toMSecsSinceEpoch() / 1000));
+
+    int row = model->rowForId(alarm->id());
+    QVERIFY(row >= 0);
+    QCOMPARE(model->data(model->index(row, 0), AlarmsBackendModel::NextTriggerTimeRole).toUInt(), alarm->nextTriggerTime());
+
+    // Unscheduled alarms have no trigger time
+    alarm->setEnabled(false);
+    alarm->save();
+    QTRY_COMPARE(alarm->nextTriggerTime(), 0u);
+    row = model->rowForId(alarm->id());
+    QCOMPARE(model->data(model->index(row, 0), AlarmsBackendModel::NextTriggerTimeRole).toUInt(), 0u);
+
+    alarm->deleteAlarm();
+}
+
 #include "tst_alarmsbackendmodel.moc"
 QTEST_MAIN(tst_AlarmsBackendModel)